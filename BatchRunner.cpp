@@ -0,0 +1,133 @@
+#include "BatchRunner.h"
+#include "ThreadPool.h"
+#include <functional>
+#include <mutex>
+
+// Fraction of games won
+double BatchReport::winRate() const {
+    return moveCounts.empty() ? 0.0 : double(wins) / moveCounts.size();
+}
+
+// Average time to choose a move
+double BatchReport::msPerMove() const {
+    return totalMoves == 0 ? 0.0 : totalSearchMs / totalMoves;
+}
+
+// Average search nodes per move
+double BatchReport::nodesPerMove() const {
+    return totalMoves == 0 ? 0.0 : double(totalSearchNodes) / totalMoves;
+}
+
+// Nearest-rank percentile of the move counts
+int BatchReport::movePercentile(double percentile) const {
+    if (moveCounts.empty()) return 0;
+    vector<int> sorted = moveCounts;
+    sort(sorted.begin(), sorted.end());
+    size_t rank = size_t(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+    return sorted[min(rank, sorted.size() - 1)];
+}
+
+// Constructor
+BatchRunner::BatchRunner(int threads) : threadCount(threads) {
+    if (threadCount <= 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+}
+
+// Play all games of one configuration; every game has its own seeded GridGame and AI
+BatchReport BatchRunner::run(const BatchConfig& config) const {
+    vector<GameResult> results(config.games);
+    ThreadPool pool(threadCount);
+    bool saveCache = !config.cacheRunPath.empty() && config.aiType == AiType::Expectimax;
+    CacheRun cacheRun;
+    size_t compactedSize = 0;
+    mutex cacheRunMutex;
+
+    vector<function<void()>> jobs;
+    for (int i = 0; i < config.games; i++) {
+        jobs.push_back([&, i] {
+            GridGame game(config.gridSize, config.startNumber, config.seed + i, config.search);
+            results[i] = game.playHeadless(config.aiType);
+            if (saveCache) {
+                // Games repeat each other's positions; fold the repeats as the run grows
+                lock_guard<mutex> lock(cacheRunMutex);
+                game.exportSearchCache(cacheRun);
+                if (cacheRun.records.size() >= 2 * compactedSize + (1 << 20)) {
+                    PersistentCache::compact(cacheRun.records);
+                    compactedSize = cacheRun.records.size();
+                }
+            }
+        });
+    }
+
+    auto start = chrono::steady_clock::now();
+    pool.runBatch(jobs);
+    if (saveCache) {
+        PersistentCache::write(config.cacheRunPath, cacheRun);
+    }
+
+    BatchReport report = {config, 0, {}, 0, 0.0, 0, 0.0};
+    report.wallMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    for (const auto& result : results) {
+        if (result.won) report.wins++;
+        report.moveCounts.push_back(result.moves);
+        report.totalMoves += result.moves;
+        report.totalSearchMs += result.searchMs;
+        report.totalSearchNodes += result.searchNodes;
+    }
+    return report;
+}
+
+// CSV output
+void BatchRunner::writeCsv(ostream& out, const vector<BatchReport>& reports) {
+    out << "grid_size,start_number,depth,search_threads,prob_cutoff,time_budget_ms,ai,games,seed,wins,win_rate,"
+        << "moves_min,moves_p50,moves_p90,moves_max,moves_mean,ms_per_move,nodes_per_move,wall_ms\n";
+    for (const auto& r : reports) {
+        out << r.config.gridSize << ',' << r.config.startNumber << ',' << r.config.search.depth << ','
+            << r.config.search.threads << ',' << r.config.search.probabilityCutoff << ','
+            << r.config.search.timeBudgetMs << ','
+            << aiName(r.config.aiType) << ',' << r.config.games << ',' << r.config.seed << ','
+            << r.wins << ',' << r.winRate() << ','
+            << r.movePercentile(0) << ',' << r.movePercentile(50) << ','
+            << r.movePercentile(90) << ',' << r.movePercentile(100) << ','
+            << (r.moveCounts.empty() ? 0.0 : double(r.totalMoves) / r.moveCounts.size()) << ','
+            << r.msPerMove() << ',' << r.nodesPerMove() << ',' << r.wallMs << '\n';
+    }
+}
+
+// JSON output
+void BatchRunner::writeJson(ostream& out, const vector<BatchReport>& reports) {
+    out << "[\n";
+    for (size_t k = 0; k < reports.size(); k++) {
+        const auto& r = reports[k];
+        out << "  {\"grid_size\": " << r.config.gridSize
+            << ", \"start_number\": " << r.config.startNumber
+            << ", \"depth\": " << r.config.search.depth
+            << ", \"search_threads\": " << r.config.search.threads
+            << ", \"prob_cutoff\": " << r.config.search.probabilityCutoff
+            << ", \"time_budget_ms\": " << r.config.search.timeBudgetMs
+            << ", \"ai\": \"" << aiName(r.config.aiType) << "\""
+            << ", \"games\": " << r.config.games
+            << ", \"seed\": " << r.config.seed
+            << ", \"wins\": " << r.wins
+            << ", \"win_rate\": " << r.winRate()
+            << ", \"ms_per_move\": " << r.msPerMove()
+            << ", \"nodes_per_move\": " << r.nodesPerMove()
+            << ", \"wall_ms\": " << r.wallMs
+            << ", \"moves\": {\"min\": " << r.movePercentile(0)
+            << ", \"p50\": " << r.movePercentile(50)
+            << ", \"p90\": " << r.movePercentile(90)
+            << ", \"max\": " << r.movePercentile(100)
+            << ", \"counts\": [";
+        for (size_t i = 0; i < r.moveCounts.size(); i++) {
+            out << (i ? ", " : "") << r.moveCounts[i];
+        }
+        out << "]}}" << (k + 1 < reports.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+// Command-line name of an AI type
+string BatchRunner::aiName(AiType type) {
+    return type == AiType::Expectimax ? "expectimax" : "smartmerge";
+}
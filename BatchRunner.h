@@ -0,0 +1,66 @@
+#ifndef BATCHRUNNER_H_INCLUDED
+#define BATCHRUNNER_H_INCLUDED
+
+#include "GridGame.h"
+#include <vector>
+#include <string>
+#include <ostream>
+
+using namespace std;
+
+// One configuration to measure
+struct BatchConfig {
+    int gridSize;
+    int startNumber;
+    AiType aiType;
+    int games;      // Number of independent games
+    unsigned seed;  // Game i is seeded with seed + i
+    string cacheRunPath; // Expectimax values of every game are written here for merging, empty for none
+    SearchSettings search; // Depth, weights and threads of the Expectimax AI
+};
+
+// Aggregated results of all games of one configuration
+struct BatchReport {
+    BatchConfig config;
+    int wins;
+    vector<int> moveCounts; // Moves of every game, in game order
+    long totalMoves;
+    double totalSearchMs;   // Time spent choosing moves over all games
+    long long totalSearchNodes; // Nodes searched over all games
+    double wallMs;          // Wall-clock time of the whole batch
+
+    double winRate() const;
+    double msPerMove() const;
+    double nodesPerMove() const;
+
+    // Returns the move count at a percentile (0-100) of the distribution
+    int movePercentile(double percentile) const;
+};
+
+/**
+ * @class BatchRunner
+ * @brief Plays many seeded headless games per configuration on all cores
+ *        and reports win rate, move counts and time per move.
+ */
+class BatchRunner {
+private:
+    int threadCount; // Games played at the same time
+
+public:
+    // Constructor; threads <= 0 uses every hardware thread
+    explicit BatchRunner(int threads = 0);
+
+    // Plays every game of a configuration
+    BatchReport run(const BatchConfig& config) const;
+
+    // Writes reports as CSV with a header row
+    static void writeCsv(ostream& out, const vector<BatchReport>& reports);
+
+    // Writes reports as a JSON array
+    static void writeJson(ostream& out, const vector<BatchReport>& reports);
+
+    // Returns the command-line name of an AI type
+    static string aiName(AiType type);
+};
+
+#endif // BATCHRUNNER_H_INCLUDED
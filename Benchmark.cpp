@@ -0,0 +1,414 @@
+/** reverse2048 benchmark
+ * Microbenchmarks for the game rules and the search kernels.
+ *
+ * Prints one CSV row per benchmark:
+ *   benchmark,grid_size,depth,ops,ns_per_op,nodes_per_sec,allocs_per_op
+ *
+ * Usage:
+ *   benchmark [--min-ms 200] [--positions 3] [--max-depth 7] [--budget-ms 50]
+ *   benchmark --compare-inplace 20
+ *   benchmark --compare-threads 20
+ *
+ * The ExpectimaxAI::getBestMove/budget rows search under a --budget-ms time budget up to
+ * --max-depth; their ns_per_op is the time per move and their depth the shallowest depth any
+ * of the positions completed.
+ *
+ * --compare-inplace plays that many seeded games per grid size instead and checks that the
+ * in-place search picks the same move as the copying search in every position;
+ * --compare-threads does the same for a search on 4 threads against the sequential one.
+ * Both print
+ *   grid_size,games,moves,mismatches
+ * and exit with 1 if any move differs.
+ */
+#include "GridGame.h"
+#include "ExpectimaxAI.h"
+#include <atomic>
+#include <new>
+#include <cstdlib>
+
+// Counts every heap allocation made by the process. The replacements are kept out of line
+// so GCC does not pair the inlined free() with operator new and warn about it.
+static atomic<long long> allocationCount(0);
+
+__attribute__((noinline)) void* operator new(size_t size)
+{
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1))
+        return p;
+    throw bad_alloc();
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+// Keeps benchmarked results alive so the compiler cannot drop the work
+static volatile uint64_t sink;
+
+class Benchmark
+{
+private:
+    struct Result
+    {
+        string name;
+        int gridSize, depth;
+        long long ops;
+        double nsPerOp, nodesPerSec, allocsPerOp;
+    };
+
+    static const int BOARD_COUNT = 64; // Positions cycled through by the kernel benchmarks
+
+    int minMs;          // Minimum measuring time per kernel benchmark
+    int positions;      // Positions searched per getBestMove benchmark
+    int maxDepth;       // Deepest getBestMove benchmark
+    int budgetMs;       // Time budget of the getBestMove/budget benchmark
+    vector<Result> results;
+
+    // Random mid-game grid: tiles between 4 and 512 on roughly half the cells
+    static vector<vector<int>> randomGrid(mt19937& rng, int size, int number)
+    {
+        vector<vector<int>> g(size, vector<int>(size, -1));
+        for (int i = 0; i < size; i++)
+            for (int j = 0; j < size; j++)
+                if (rng() % 2)
+                    g[i][j] = 4 << (rng() % 8);
+        g[size - 1][size - 1] = number;
+        return g;
+    }
+
+    // Default search settings at another depth
+    static SearchSettings searchAtDepth(int depth)
+    {
+        SearchSettings search;
+        search.depth = depth;
+        return search;
+    }
+
+    // Runs op in growing batches until minMs have passed; op returns the nodes it searched
+    template <typename Op>
+    void measure(const string& name, int size, int depth, Op op)
+    {
+        long long ops = 0, nodes = 0, allocations = 0;
+        double elapsedNs = 0;
+        for (long long batch = 16; elapsedNs < minMs * 1e6; batch *= 2)
+        {
+            long long allocBefore = allocationCount.load();
+            auto start = chrono::steady_clock::now();
+            for (long long k = 0; k < batch; k++)
+                nodes += op(ops + k);
+            elapsedNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            allocations += allocationCount.load() - allocBefore;
+            ops += batch;
+        }
+        record(name, size, depth, ops, elapsedNs, nodes, allocations);
+    }
+
+    // Stores one result row
+    void record(const string& name, int size, int depth, long long ops, double elapsedNs,
+                long long nodes, long long allocations)
+    {
+        results.push_back({name, size, depth, ops, elapsedNs / ops,
+                           nodes * 1e9 / elapsedNs, double(allocations) / ops});
+    }
+
+    // GridGame rules on vector grids
+    void benchGame(int size)
+    {
+        mt19937 rng(size);
+        GridGame game(size, 256, 42, searchAtDepth(1));
+        vector<vector<vector<int>>> grids;
+        for (int k = 0; k < BOARD_COUNT; k++)
+            grids.push_back(randomGrid(rng, size, 256));
+        const char dirs[4] = {'i', 'j', 'k', 'l'};
+        MoveEngine::forSize(size); // Builds the move tables outside the first timed batch
+
+        measure("GridGame::processMovement", size, 0, [&](long long k)
+        {
+            game.grid2 = grids[k % BOARD_COUNT];
+            sink = sink + game.processMovement(game.pos2, game.grid2, dirs[k % 4]);
+            return 0LL;
+        });
+        measure("GridGame::spawnRandomNumber", size, 0, [&](long long k)
+        {
+            game.grid2 = grids[k % BOARD_COUNT];
+            game.spawnRandomNumber(game.grid2);
+            return 0LL;
+        });
+        measure("GridGame::checkGameOver", size, 0, [&](long long k)
+        {
+            sink = sink + game.checkGameOver(grids[k % BOARD_COUNT]);
+            return 0LL;
+        });
+    }
+
+    // ExpectimaxAI kernels on packed boards
+    void benchSearchKernels(int size)
+    {
+        mt19937 rng(size);
+        GridGame game(size, 256, 42, searchAtDepth(1));
+        ExpectimaxAI& ai = game.expectimaxAi();
+        vector<PackedBoard> boards;
+        vector<SymmetricHash> images(BOARD_COUNT);
+        vector<uint64_t> hashes;
+        for (int k = 0; k < BOARD_COUNT; k++)
+        {
+            boards.push_back(ai.layout.pack(randomGrid(rng, size, 256), -1));
+            ai.symmetry.hash(boards.back(), images[k]);
+            hashes.push_back(ai.symmetry.canonical(images[k]));
+        }
+        const char dirs[4] = {'i', 'j', 'k', 'l'};
+
+        measure("ExpectimaxAI::simulateMove", size, 0, [&](long long k)
+        {
+            bool changed;
+            sink = sink + ai.simulateMove(boards[k % BOARD_COUNT], dirs[k % 4], changed).lo + changed;
+            return 0LL;
+        });
+        measure("ExpectimaxAI::evaluateGrid", size, 0, [&](long long k)
+        {
+            sink = sink + uint64_t(ai.evaluateGrid(boards[k % BOARD_COUNT]));
+            return 0LL;
+        });
+        measure("ExpectimaxAI::checkGameOver", size, 0, [&](long long k)
+        {
+            sink = sink + ai.checkGameOver(boards[k % BOARD_COUNT]);
+            return 0LL;
+        });
+        measure("ExpectimaxAI::getEmptyCells", size, 0, [&](long long k)
+        {
+            sink = sink + ai.getEmptyCells(boards[k % BOARD_COUNT]);
+            return 0LL;
+        });
+        measure("BoardSymmetry::hash", size, 0, [&](long long k)
+        {
+            SymmetricHash h;
+            ai.symmetry.hash(boards[k % BOARD_COUNT], h);
+            sink = sink + ai.symmetry.canonical(h);
+            return 0LL;
+        });
+        measure("BoardSymmetry::update", size, 0, [&](long long k)
+        {
+            const PackedBoard& b = boards[k % BOARD_COUNT];
+            bool changed;
+            PackedBoard moved = ai.simulateMove(b, dirs[k % 4], changed);
+            SymmetricHash h = images[k % BOARD_COUNT];
+            ai.symmetry.update(h, b, moved);
+            sink = sink + ai.symmetry.canonical(h);
+            return 0LL;
+        });
+
+        for (int k = 0; k < BOARD_COUNT; k++)
+            ai.evalCache.store(hashes[k], 3, TranspositionTable::MAX_NODE, k);
+        measure("TranspositionTable::probe", size, 0, [&](long long k)
+        {
+            double value;
+            int reachExponent;
+            sink = sink + ai.evalCache.probe(hashes[k % BOARD_COUNT], 3, TranspositionTable::MAX_NODE, INT_MAX,
+                                             value, reachExponent);
+            return 0LL;
+        });
+        measure("TranspositionTable::store", size, 0, [&](long long k)
+        {
+            ai.evalCache.store(hashes[k % BOARD_COUNT] + k, 3, TranspositionTable::MAX_NODE, k);
+            return 0LL;
+        });
+    }
+
+    // Full searches from fresh caches: sequential, on two threads, and sequential with the
+    // in-place search. Each AI searches once before measuring so the cache pages and the task
+    // blocks are already in place
+    void benchBestMove(int size)
+    {
+        mt19937 rng(size);
+        vector<vector<vector<int>>> grids;
+        for (int k = 0; k < positions; k++)
+            grids.push_back(randomGrid(rng, size, 256));
+
+        const char* names[3] = {"ExpectimaxAI::getBestMove", "ExpectimaxAI::getBestMove/2threads",
+                                "ExpectimaxAI::getBestMove/inplace"};
+        for (int variant = 0; variant < 3; variant++)
+        {
+            string name = names[variant];
+            for (int depth = 3; depth <= maxDepth; depth++)
+            {
+                vector<vector<int>> grid = grids[0];
+                Position pos = {0, 0};
+                ExpectimaxAI ai(grid, pos, size, 256, depth, -1);
+                ai.setThreadCount(variant == 1 ? 2 : 1);
+                ai.setInPlaceSearch(variant == 2);
+                ai.setTablebaseProbing(false); // Time the search even where precomputed moves exist
+                ai.setOpeningBookProbing(false);
+                ai.setPersistentCacheProbing(false);
+                ai.getBestMove();
+
+                double elapsedNs = 0;
+                long long nodes = 0, allocations = 0;
+                for (int k = 0; k < positions; k++)
+                {
+                    grid = grids[k];
+                    ai.resetCache();
+                    long long allocBefore = allocationCount.load();
+                    auto start = chrono::steady_clock::now();
+                    sink = sink + ai.getBestMove();
+                    elapsedNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+                    allocations += allocationCount.load() - allocBefore;
+                    nodes += ai.getSearchStats().totalNodes();
+                }
+                record(name, size, depth, positions, elapsedNs, nodes, allocations);
+            }
+        }
+    }
+
+    // Searches under the time budget: the time a move takes and the depth it reaches
+    void benchBudget(int size)
+    {
+        mt19937 rng(size);
+        vector<vector<vector<int>>> grids;
+        for (int k = 0; k < positions; k++)
+            grids.push_back(randomGrid(rng, size, 256));
+
+        vector<vector<int>> grid = grids[0];
+        Position pos = {0, 0};
+        ExpectimaxAI ai(grid, pos, size, 256, maxDepth, -1);
+        ai.setTablebaseProbing(false);
+        ai.setOpeningBookProbing(false);
+        ai.setPersistentCacheProbing(false);
+        ai.setTimeBudget(budgetMs);
+        ai.getBestMove();
+
+        double elapsedNs = 0;
+        long long nodes = 0, allocations = 0;
+        int shallowest = maxDepth;
+        for (int k = 0; k < positions; k++)
+        {
+            grid = grids[k];
+            ai.resetCache();
+            long long allocBefore = allocationCount.load();
+            auto start = chrono::steady_clock::now();
+            sink = sink + ai.getBestMove();
+            elapsedNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+            allocations += allocationCount.load() - allocBefore;
+            nodes += ai.getSearchStats().totalNodes();
+            shallowest = min(shallowest, ai.getSearchStats().completedDepth);
+        }
+        record("ExpectimaxAI::getBestMove/budget" + to_string(budgetMs) + "ms", size, shallowest, positions,
+               elapsedNs, nodes, allocations);
+    }
+
+public:
+    static const int COMPARE_DEPTH = 4;   // Search depth of the move comparisons
+    static const int COMPARE_THREADS = 4; // Threads of the parallel search in --compare-threads
+
+    Benchmark(int minMilliseconds, int positionCount, int deepest, int budgetMilliseconds)
+        : minMs(minMilliseconds), positions(positionCount), maxDepth(deepest), budgetMs(budgetMilliseconds)
+    {
+    }
+
+    // Runs every benchmark for grid sizes 3 to 5
+    void runAll()
+    {
+        for (int size = 3; size <= 5; size++)
+        {
+            benchGame(size);
+            benchSearchKernels(size);
+            benchBestMove(size);
+            benchBudget(size);
+        }
+    }
+
+    // Plays seeded games with the default sequential search and asks a second AI on the same
+    // grid, set up by configure, for its move in every position; returns the positions where
+    // the two differ
+    template <typename Configure>
+    static int compareMoves(int games, Configure configure, ostream& out)
+    {
+        out << "grid_size,games,moves,mismatches\n";
+        int totalMismatches = 0;
+        for (int size = 3; size <= 5; size++)
+        {
+            long long moves = 0;
+            int mismatches = 0;
+            for (int seed = 0; seed < games; seed++)
+            {
+                GridGame game(size, 256, unsigned(seed), searchAtDepth(COMPARE_DEPTH));
+                ExpectimaxAI other(game.grid2, game.pos2, size, 256, COMPARE_DEPTH, -1);
+                configure(other);
+                for (ExpectimaxAI* ai : {&game.expectimaxAi(), &other})
+                {
+                    ai->setTablebaseProbing(false); // Precomputed moves would skip the search
+                    ai->setOpeningBookProbing(false);
+                    ai->setPersistentCacheProbing(false);
+                }
+
+                while (!game.checkGameOver(game.grid2))
+                {
+                    char move = game.expectimaxAi().getBestMove();
+                    if (other.getBestMove() != move)
+                        mismatches++;
+                    if (move == 'n' || !game.processMovement(game.pos2, game.grid2, move))
+                        break;
+                    moves++;
+                }
+            }
+            out << size << ',' << games << ',' << moves << ',' << mismatches << '\n';
+            totalMismatches += mismatches;
+        }
+        return totalMismatches;
+    }
+
+    // Prints the results as CSV
+    void writeCsv(ostream& out) const
+    {
+        out << "benchmark,grid_size,depth,ops,ns_per_op,nodes_per_sec,allocs_per_op\n";
+        for (const auto& r : results)
+        {
+            out << r.name << ',' << r.gridSize << ',' << r.depth << ',' << r.ops << ','
+                << fixed << setprecision(2) << r.nsPerOp << ',' << setprecision(0) << r.nodesPerSec
+                << ',' << setprecision(3) << r.allocsPerOp << '\n';
+        }
+    }
+};
+
+// Entry point of the benchmark
+int main(int argc, char* argv[])
+{
+    int minMs = 200, positions = 3, maxDepth = 7, budgetMs = 50, compareInPlaceGames = 0, compareThreadGames = 0;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        string option = argv[i];
+        int value = atoi(argv[i + 1]);
+        if (option == "--min-ms") minMs = value;
+        else if (option == "--positions") positions = value;
+        else if (option == "--max-depth") maxDepth = value;
+        else if (option == "--budget-ms") budgetMs = value;
+        else if (option == "--compare-inplace") compareInPlaceGames = value;
+        else if (option == "--compare-threads") compareThreadGames = value;
+        else
+        {
+            cerr << "Unknown option: " << option << endl;
+            return 1;
+        }
+    }
+
+    if (compareInPlaceGames > 0)
+    {
+        auto inPlace = [](ExpectimaxAI& ai) { ai.setInPlaceSearch(true); };
+        return Benchmark::compareMoves(compareInPlaceGames, inPlace, cout) == 0 ? 0 : 1;
+    }
+    if (compareThreadGames > 0)
+    {
+        auto parallel = [](ExpectimaxAI& ai) { ai.setThreadCount(Benchmark::COMPARE_THREADS); };
+        return Benchmark::compareMoves(compareThreadGames, parallel, cout) == 0 ? 0 : 1;
+    }
+
+    Benchmark benchmark(minMs, positions, maxDepth, budgetMs);
+    benchmark.runAll();
+    benchmark.writeCsv(cout);
+    return 0;
+}
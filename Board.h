@@ -0,0 +1,148 @@
+#ifndef BOARD_H_INCLUDED
+#define BOARD_H_INCLUDED
+
+#include "PackedBoard.h"
+#include <cstdint>
+#include <type_traits>
+#include <stdexcept>
+
+using namespace std;
+
+/**
+ * @struct Board
+ * @brief Packed board kernels with the grid size fixed at compile time.
+ *        BoardLayout works for any size; Board<N> knows where every row lives, so the
+ *        search's hot loops have constant bounds and straight-line row accesses.
+ */
+template <int N>
+struct Board
+{
+    static_assert(N >= 3 && N <= 5, "Grid size must be between 3 and 5");
+
+    static constexpr int CELLS = N * N;
+    static constexpr int ROWS_IN_LO = 64 / (4 * N);                  // Rows stored in the low word
+    static constexpr int CELLS_IN_LO = (ROWS_IN_LO < N ? ROWS_IN_LO : N) * N; // Cells stored in the low word
+    static constexpr uint32_t ROW_MASK = (1u << (4 * N)) - 1;        // Bits of one row
+    static constexpr uint32_t ROW_ONES = uint32_t(0x11111111u & ROW_MASK); // 0x1 in every nibble of a row
+
+    // 0x1 in every nibble of a word that holds a cell
+    static uint64_t cellOnes(int cells)
+    {
+        return cells >= 16 ? 0x1111111111111111ULL : 0x1111111111111111ULL & ((1ULL << (cells * 4)) - 1);
+    }
+
+    // Bit 4k set where nibble k of a word is zero
+    static uint64_t zeroNibbles(uint64_t w)
+    {
+        return ~(w | (w >> 1) | (w >> 2) | (w >> 3)) & 0x1111111111111111ULL;
+    }
+
+    // Moves bit 4k of a word to bit k
+    static uint32_t compactNibbles(uint64_t x)
+    {
+        x = (x | (x >> 3)) & 0x0303030303030303ULL;
+        x = (x | (x >> 6)) & 0x000F000F000F000FULL;
+        x = (x | (x >> 12)) & 0x000000FF000000FFULL;
+        x = (x | (x >> 24)) & 0xFFFFULL;
+        return uint32_t(x);
+    }
+
+    // Returns the codes of a whole row, column 0 in the lowest nibble
+    static uint32_t getRow(const PackedBoard& b, int row)
+    {
+        return row < ROWS_IN_LO ? uint32_t(b.lo >> (row * N * 4)) & ROW_MASK
+                                : uint32_t(b.hi >> ((row - ROWS_IN_LO) * N * 4)) & ROW_MASK;
+    }
+
+    // Replaces the codes of a whole row
+    static void setRow(PackedBoard& b, int row, uint32_t bits)
+    {
+        uint64_t& word = row < ROWS_IN_LO ? b.lo : b.hi;
+        int shift = (row < ROWS_IN_LO ? row : row - ROWS_IN_LO) * N * 4;
+        word = (word & ~(uint64_t(ROW_MASK) << shift)) | (uint64_t(bits) << shift);
+    }
+
+    // Returns the tile code of a cell (cell = row * N + col)
+    static int getCell(const PackedBoard& b, int cell)
+    {
+        return cell < CELLS_IN_LO ? int(b.lo >> (cell * 4)) & 0xF
+                                  : int(b.hi >> ((cell - CELLS_IN_LO) * 4)) & 0xF;
+    }
+
+    // Puts a tile code on an empty cell (cell = row * N + col)
+    static void placeTile(PackedBoard& b, int cell, int code)
+    {
+        if (cell < CELLS_IN_LO)
+            b.lo |= uint64_t(code) << (cell * 4);
+        else
+            b.hi |= uint64_t(code) << ((cell - CELLS_IN_LO) * 4);
+    }
+
+    // Empties a cell again (cell = row * N + col)
+    static void clearTile(PackedBoard& b, int cell)
+    {
+        if (cell < CELLS_IN_LO)
+            b.lo &= ~(0xFULL << (cell * 4));
+        else
+            b.hi &= ~(0xFULL << ((cell - CELLS_IN_LO) * 4));
+    }
+
+    // Returns a bitmask of empty cells, bit (row * N + col)
+    static uint32_t emptyCells(const PackedBoard& b)
+    {
+        uint32_t mask = compactNibbles(zeroNibbles(b.lo) & cellOnes(CELLS_IN_LO));
+        if (CELLS > CELLS_IN_LO)
+            mask |= compactNibbles(zeroNibbles(b.hi) & cellOnes(CELLS - CELLS_IN_LO)) << CELLS_IN_LO;
+        return mask;
+    }
+
+    // Checks if any cell holds code 1, the winning value
+    static bool hasValueOne(const PackedBoard& b)
+    {
+        const uint64_t ones = 0x1111111111111111ULL;
+        bool found = (zeroNibbles(b.lo ^ ones) & cellOnes(CELLS_IN_LO)) != 0;
+        if (CELLS > CELLS_IN_LO)
+            found = found || (zeroNibbles(b.hi ^ ones) & cellOnes(CELLS - CELLS_IN_LO)) != 0;
+        return found;
+    }
+
+    // Checks if any move is possible: an empty cell or two equal neighbours
+    static bool canMove(const PackedBoard& b)
+    {
+        if (emptyCells(b) != 0) return true;
+        uint32_t previous = 0;
+        for (int i = 0; i < N; i++)
+        {
+            uint32_t row = getRow(b, i);
+            uint32_t sameAsRight = uint32_t(zeroNibbles(row ^ (row >> 4))) & (ROW_ONES >> 4);
+            if (sameAsRight != 0) return true;
+            if (i > 0 && (uint32_t(zeroNibbles(row ^ previous)) & ROW_ONES) != 0) return true;
+            previous = row;
+        }
+        return false;
+    }
+
+    // Checks if the game is over: won, or no move possible
+    static bool isGameOver(const PackedBoard& b)
+    {
+        return hasValueOne(b) || !canMove(b);
+    }
+};
+
+// Calls f with integral_constant<int, size> so it can use Board<size>; sizes 3 to 5 only
+template <typename F>
+auto withBoardSize(int size, F f) -> decltype(f(integral_constant<int, 3>()))
+{
+    switch (size)
+    {
+    case 3:
+        return f(integral_constant<int, 3>());
+    case 4:
+        return f(integral_constant<int, 4>());
+    case 5:
+        return f(integral_constant<int, 5>());
+    }
+    throw invalid_argument("Grid size must be between 3 and 5");
+}
+
+#endif // BOARD_H_INCLUDED
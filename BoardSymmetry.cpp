@@ -0,0 +1,108 @@
+#include "BoardSymmetry.h"
+
+// Constructor: the key of a code on cell c in image s is the plain key of the cell c maps to,
+// so image s of a board hashes exactly like the transformed board would
+BoardSymmetry::BoardSymmetry(int size, int symmetryCount)
+    : gridSize(size), cellsInLo((64 / (size * 4)) * size), activeCount(symmetryCount)
+{
+    const Zobrist& zobrist = Zobrist::instance();
+    for (int s = 0; s < SYMMETRY_COUNT; s++)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            for (int j = 0; j < size; j++)
+            {
+                int row, col;
+                mapCell(s, size, i, j, row, col);
+                for (int code = 0; code < 16; code++)
+                    keys[s][i * size + j][code] = zobrist.cellKey(row * size + col, code);
+            }
+        }
+    }
+}
+
+// Cell mapping of each symmetry
+void BoardSymmetry::mapCell(int symmetry, int size, int row, int col, int& newRow, int& newCol)
+{
+    int last = size - 1;
+    switch (symmetry)
+    {
+    case 0: newRow = row;        newCol = col;        break; // Identity
+    case 1: newRow = col;        newCol = row;        break; // Transpose
+    case 2: newRow = col;        newCol = last - row; break; // Rotate 90 clockwise
+    case 3: newRow = last - row; newCol = last - col; break; // Rotate 180
+    case 4: newRow = last - col; newCol = row;        break; // Rotate 90 counter-clockwise
+    case 5: newRow = row;        newCol = last - col; break; // Mirror left-right
+    case 6: newRow = last - row; newCol = col;        break; // Mirror top-bottom
+    default: newRow = last - col; newCol = last - row; break; // Anti-diagonal transpose
+    }
+}
+
+// Hash every active image from scratch
+void BoardSymmetry::hash(const PackedBoard& b, SymmetricHash& h) const
+{
+    BoardLayout layout(gridSize);
+    for (int s = 0; s < activeCount; s++)
+    {
+        h.images[s] = 0;
+        for (int i = 0; i < gridSize; i++)
+            for (int j = 0; j < gridSize; j++)
+                h.images[s] ^= keys[s][i * gridSize + j][layout.getCell(b, i, j)];
+    }
+}
+
+// Incremental update, visiting only the nibbles that changed (same walk as Zobrist::update)
+void BoardSymmetry::update(SymmetricHash& h, const PackedBoard& from, const PackedBoard& to) const
+{
+    for (int word = 0; word < 2; word++)
+    {
+        uint64_t a = word == 0 ? from.lo : from.hi;
+        uint64_t b = word == 0 ? to.lo : to.hi;
+        uint64_t diff = a ^ b;
+        while (diff != 0)
+        {
+            int nibble = __builtin_ctzll(diff) / 4;
+            int shift = nibble * 4;
+            int cell = word == 0 ? nibble : cellsInLo + nibble;
+            int oldCode = (a >> shift) & 0xF, newCode = (b >> shift) & 0xF;
+            for (int s = 0; s < activeCount; s++)
+                h.images[s] ^= keys[s][cell][oldCode] ^ keys[s][cell][newCode];
+            diff &= ~(0xFULL << shift);
+        }
+    }
+}
+
+// Symmetry with the smallest image hash
+int BoardSymmetry::canonicalSymmetry(const SymmetricHash& h) const
+{
+    int best = 0;
+    for (int s = 1; s < activeCount; s++)
+        if (h.images[s] < h.images[best])
+            best = s;
+    return best;
+}
+
+// A move is a unit step, so it maps like the difference of two mapped cells
+char BoardSymmetry::mapDirection(int symmetry, char dir)
+{
+    int dr = 0, dc = 0;
+    if (dir == 'i') dr = -1;
+    else if (dir == 'k') dr = 1;
+    else if (dir == 'j') dc = -1;
+    else if (dir == 'l') dc = 1;
+    else return dir;
+
+    int r0, c0, r1, c1;
+    mapCell(symmetry, 3, 1, 1, r0, c0);
+    mapCell(symmetry, 3, 1 + dr, 1 + dc, r1, c1);
+    if (r1 < r0) return 'i';
+    if (r1 > r0) return 'k';
+    return c1 < c0 ? 'j' : 'l';
+}
+
+// Rotations by 90 degrees undo each other; every other symmetry is its own inverse
+char BoardSymmetry::unmapDirection(int symmetry, char dir)
+{
+    const int inverse[SYMMETRY_COUNT] = {0, 1, 4, 3, 2, 5, 6, 7};
+    return mapDirection(inverse[symmetry], dir);
+}
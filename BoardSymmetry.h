@@ -0,0 +1,79 @@
+#ifndef BOARDSYMMETRY_H_INCLUDED
+#define BOARDSYMMETRY_H_INCLUDED
+
+#include "PackedBoard.h"
+#include "Zobrist.h"
+#include <cstdint>
+
+using namespace std;
+
+// Zobrist hashes of one board as seen through each symmetry, index 0 being the board itself
+struct SymmetricHash
+{
+    uint64_t images[8];
+};
+
+/**
+ * @class BoardSymmetry
+ * @brief Folds boards that are reflections or rotations of each other onto one cache key.
+ *        Symmetries 0 and 1 are the identity and the main-diagonal transpose; 2 to 7 are the
+ *        rotations and the remaining reflections. Only the first activeCount are used, so a
+ *        search can fold exactly the symmetries its evaluation does not tell apart.
+ */
+class BoardSymmetry
+{
+private:
+    static const int MAX_CELLS = 25;
+    static const int SYMMETRY_COUNT = 8;
+
+    int gridSize;         // Grid dimensions
+    int cellsInLo;        // Cells stored in the low word of a PackedBoard
+    int activeCount;      // Symmetries currently folded (1, 2 or 8)
+    uint64_t keys[SYMMETRY_COUNT][MAX_CELLS][16]; // Key of a code on a cell after each symmetry
+
+public:
+    // Maps a cell through a symmetry
+    static void mapCell(int symmetry, int size, int row, int col, int& newRow, int& newCol);
+
+    // Constructor builds the image keys for a grid size and folds symmetryCount symmetries
+    BoardSymmetry(int size, int symmetryCount);
+
+    // Changes how many symmetries are folded; cached keys from before are no longer comparable
+    void setActiveCount(int symmetryCount) { activeCount = symmetryCount; }
+
+    // Returns how many symmetries are folded
+    int getActiveCount() const { return activeCount; }
+
+    // Hashes every active image of a board
+    void hash(const PackedBoard& b, SymmetricHash& h) const;
+
+    // Updates the images for the cells that differ between two boards
+    void update(SymmetricHash& h, const PackedBoard& from, const PackedBoard& to) const;
+
+    // Updates the images for a tile placed on an empty cell (cell = row * gridSize + col)
+    void place(SymmetricHash& h, int cell, int code) const
+    {
+        for (int s = 0; s < activeCount; s++)
+            h.images[s] ^= keys[s][cell][code];
+    }
+
+    // Returns the cache key of the board's class: the smallest active image hash
+    uint64_t canonical(const SymmetricHash& h) const
+    {
+        uint64_t key = h.images[0];
+        for (int s = 1; s < activeCount; s++)
+            key = min(key, h.images[s]);
+        return key;
+    }
+
+    // Returns the symmetry whose image gives the canonical key
+    int canonicalSymmetry(const SymmetricHash& h) const;
+
+    // Returns the direction on the image board that matches dir on the original board
+    static char mapDirection(int symmetry, char dir);
+
+    // Returns the direction on the original board that matches dir on the image board
+    static char unmapDirection(int symmetry, char dir);
+};
+
+#endif // BOARDSYMMETRY_H_INCLUDED
@@ -0,0 +1,305 @@
+#include "EndgameTablebase.h"
+#include "Board.h"
+#include "BoardSymmetry.h"
+#include "MoveEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+// Where each row of a 3x3 board lands under each symmetry; an image is the OR of three rows
+struct RowImages
+{
+    uint64_t rows[8][3][4096];
+
+    RowImages()
+    {
+        for (int s = 0; s < 8; s++)
+        {
+            for (int r = 0; r < 3; r++)
+            {
+                for (uint32_t bits = 0; bits < 4096; bits++)
+                {
+                    uint64_t image = 0;
+                    for (int c = 0; c < 3; c++)
+                    {
+                        int row, col;
+                        BoardSymmetry::mapCell(s, 3, r, c, row, col);
+                        image |= uint64_t((bits >> (c * 4)) & 0xF) << ((row * 3 + col) * 4);
+                    }
+                    rows[s][r][bits] = image;
+                }
+            }
+        }
+    }
+};
+
+// Row images shared by every tablebase
+static const RowImages& rowImages()
+{
+    static const RowImages images;
+    return images;
+}
+
+// Checks if any cell of a 3x3 board holds a code
+static bool hasCode(uint64_t board, int code)
+{
+    return (Board<3>::zeroNibbles(board ^ (0x111111111ULL * code)) & Board<3>::cellOnes(9)) != 0;
+}
+
+// Sorts a list of boards and drops the repeats
+static void sortUnique(vector<uint64_t>& keys)
+{
+    sort(keys.begin(), keys.end());
+    keys.erase(unique(keys.begin(), keys.end()), keys.end());
+}
+
+// Constructor
+EndgameTablebase::EndgameTablebase()
+    : records(nullptr), recordCount(0)
+{
+}
+
+// Smallest image over all eight symmetries
+uint64_t EndgameTablebase::canonical(uint64_t board, int& symmetry)
+{
+    const RowImages& images = rowImages();
+    uint32_t row0 = board & 0xFFF, row1 = (board >> 12) & 0xFFF, row2 = (board >> 24) & 0xFFF;
+    uint64_t best = board;
+    symmetry = 0;
+    for (int s = 1; s < 8; s++)
+    {
+        uint64_t image = images.rows[s][0][row0] | images.rows[s][1][row1] | images.rows[s][2][row2];
+        if (image < best)
+        {
+            best = image;
+            symmetry = s;
+        }
+    }
+    return best;
+}
+
+// File name of a tablebase
+string EndgameTablebase::defaultPath(int startNumber)
+{
+    return "tablebase3x3_" + to_string(startNumber) + ".bin";
+}
+
+// Map each start number's file once; a missing file is looked for again next time
+shared_ptr<const EndgameTablebase> EndgameTablebase::forNumber(int startNumber)
+{
+    static mutex registryMutex;
+    static map<int, shared_ptr<const EndgameTablebase>> registry;
+
+    lock_guard<mutex> lock(registryMutex);
+    auto found = registry.find(startNumber);
+    if (found != registry.end())
+        return found->second;
+
+    string path = defaultPath(startNumber);
+    shared_ptr<EndgameTablebase> tablebase(new EndgameTablebase());
+    if (!tablebase->file.open(path))
+        return nullptr;
+
+    FileHeader header;
+    if (tablebase->file.size() < sizeof(header))
+        throw runtime_error("Malformed tablebase file: " + path);
+    memcpy(&header, tablebase->file.data(), sizeof(header));
+    if (header.magic != FILE_MAGIC || header.version != FILE_VERSION ||
+        header.startNumber != uint32_t(startNumber) ||
+        tablebase->file.size() != sizeof(header) + header.recordCount * sizeof(uint64_t))
+        throw runtime_error("Malformed tablebase file: " + path);
+
+    tablebase->records = reinterpret_cast<const uint64_t*>(tablebase->file.data() + sizeof(header));
+    tablebase->recordCount = size_t(header.recordCount);
+    registry[startNumber] = tablebase;
+    return tablebase;
+}
+
+// Enumerate the reachable positions level by level from the openings, then solve the levels
+// from the top down: a position's successors always sit on higher levels, so they are solved
+// before it is
+size_t EndgameTablebase::build(int startNumber, const string& path, ostream& log)
+{
+    if (startNumber != 128 && startNumber != 256 && startNumber != 512)
+        throw invalid_argument("Number must be 128, 256, or 512");
+
+    auto buildStart = chrono::steady_clock::now();
+    const MoveEngine& engine = MoveEngine::forSize(3);
+    const char directions[4] = {'i', 'j', 'k', 'l'};
+    const int startCode = BoardLayout::toCode(startNumber, -1);
+    const int winCode = BoardLayout::toCode(2, -1);
+    const int spawnCodes[3] = {startCode - 1, startCode - 2, startCode - 3};
+
+    // A tile's weight is startNumber / value, so a level is startNumber times the sum of 1 / v.
+    // Positions still in play hold no 2, which bounds the highest level
+    auto weight = [startCode](int code) { return 1 << (startCode - code); };
+    const int levelCount = 9 * weight(winCode + 1) + 1;
+    const int openingLevel = 2 * weight(startCode);
+
+    // Forward pass: every position that can be reached and still has a move
+    log << "3x3 tablebase for " << startNumber << ": enumerating positions" << endl;
+    vector<vector<uint64_t>> levels(levelCount);
+    vector<size_t> compactedSize(levelCount, 0);
+    int symmetry;
+    for (int a = 0; a < 9; a++)
+        for (int b = a + 1; b < 9; b++)
+            levels[openingLevel].push_back(canonical(uint64_t(startCode) << (a * 4) |
+                                                     uint64_t(startCode) << (b * 4), symmetry));
+
+    size_t positionCount = 0;
+    for (int level = 0; level < levelCount; level++)
+    {
+        vector<uint64_t>& keys = levels[level];
+        sortUnique(keys);
+        keys.shrink_to_fit();
+        positionCount += keys.size();
+        for (uint64_t key : keys)
+        {
+            PackedBoard board = {key, 0};
+            for (char dir : directions)
+            {
+                PackedBoard moved = engine.move<3>(board, dir);
+                if (moved == board || hasCode(moved.lo, winCode)) continue;
+                for (uint32_t cells = Board<3>::emptyCells(moved); cells != 0; cells &= cells - 1)
+                {
+                    int cell = __builtin_ctz(cells);
+                    for (int code : spawnCodes)
+                    {
+                        PackedBoard spawned = moved;
+                        Board<3>::placeTile(spawned, cell, code);
+                        if (!Board<3>::canMove(spawned)) continue;
+
+                        // The same successor comes from many positions; fold the repeats
+                        // whenever a level's list has doubled since it was last folded
+                        int next = level + weight(code);
+                        levels[next].push_back(canonical(spawned.lo, symmetry));
+                        if (levels[next].size() >= 2 * compactedSize[next] + (1 << 20))
+                        {
+                            sortUnique(levels[next]);
+                            compactedSize[next] = levels[next].size();
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // Backward pass: a move that merges into a 2 wins outright; otherwise it is worth the
+    // average over every spawn, where a spawn that leaves no move loses
+    log << "3x3 tablebase for " << startNumber << ": solving " << positionCount << " positions" << endl;
+    vector<vector<double>> values(levelCount);
+    vector<vector<uint8_t>> bestMoves(levelCount);
+    auto solvedValue = [&](int level, uint64_t key)
+    {
+        const vector<uint64_t>& keys = levels[level];
+        return values[level][lower_bound(keys.begin(), keys.end(), key) - keys.begin()];
+    };
+    for (int level = levelCount - 1; level >= 0; level--)
+    {
+        const vector<uint64_t>& keys = levels[level];
+        values[level].resize(keys.size());
+        bestMoves[level].resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            PackedBoard board = {keys[i], 0};
+            double best = -1.0;
+            int bestIndex = 0;
+            for (int d = 0; d < 4; d++)
+            {
+                PackedBoard moved = engine.move<3>(board, directions[d]);
+                if (moved == board) continue;
+
+                double value = 1.0;
+                if (!hasCode(moved.lo, winCode))
+                {
+                    double sum = 0.0;
+                    int outcomes = 0;
+                    for (uint32_t cells = Board<3>::emptyCells(moved); cells != 0; cells &= cells - 1)
+                    {
+                        int cell = __builtin_ctz(cells);
+                        for (int code : spawnCodes)
+                        {
+                            outcomes++;
+                            PackedBoard spawned = moved;
+                            Board<3>::placeTile(spawned, cell, code);
+                            if (Board<3>::canMove(spawned))
+                                sum += solvedValue(level + weight(code), canonical(spawned.lo, symmetry));
+                        }
+                    }
+                    value = sum / outcomes;
+                }
+                if (value > best)
+                {
+                    best = value;
+                    bestIndex = d;
+                }
+            }
+            values[level][i] = best;
+            bestMoves[level][i] = uint8_t(bestIndex);
+        }
+    }
+
+    // The opening tiles land on two different cells, every pair alike
+    double openingWin = 0.0;
+    int openings = 0;
+    for (int a = 0; a < 9; a++)
+    {
+        for (int b = a + 1; b < 9; b++)
+        {
+            openingWin += solvedValue(openingLevel, canonical(uint64_t(startCode) << (a * 4) |
+                                                              uint64_t(startCode) << (b * 4), symmetry));
+            openings++;
+        }
+    }
+    openingWin /= openings;
+
+    // Records sort by board because the board is their top field
+    vector<uint64_t> fileRecords;
+    fileRecords.reserve(positionCount);
+    for (int level = 0; level < levelCount; level++)
+    {
+        for (size_t i = 0; i < levels[level].size(); i++)
+            fileRecords.push_back(levels[level][i] << KEY_SHIFT | uint64_t(bestMoves[level][i]) << MOVE_SHIFT |
+                                  uint64_t(llround(values[level][i] * PROBABILITY_MASK)));
+        vector<uint64_t>().swap(levels[level]);
+        vector<double>().swap(values[level]);
+        vector<uint8_t>().swap(bestMoves[level]);
+    }
+    sort(fileRecords.begin(), fileRecords.end());
+
+    FileHeader header = {FILE_MAGIC, FILE_VERSION, uint32_t(startNumber), uint64_t(fileRecords.size())};
+    ofstream out(path, ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(fileRecords.data()), fileRecords.size() * sizeof(uint64_t));
+    out.close();
+    if (!out)
+        throw runtime_error("Cannot write tablebase file: " + path);
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - buildStart).count();
+    log << "3x3 tablebase for " << startNumber << ": " << fileRecords.size() << " positions, "
+        << "opening win probability " << openingWin << ", written to " << path
+        << " in " << seconds << " s" << endl;
+    return fileRecords.size();
+}
+
+// Binary search on the canonical board, then map the stored move back onto b
+bool EndgameTablebase::probe(const PackedBoard& b, char& bestMove, double& winProbability) const
+{
+    int symmetry;
+    uint64_t key = canonical(b.lo, symmetry);
+    const uint64_t* end = records + recordCount;
+    const uint64_t* found = lower_bound(records, end, key << KEY_SHIFT);
+    if (found == end || (*found >> KEY_SHIFT) != key)
+        return false;
+
+    const char directions[4] = {'i', 'j', 'k', 'l'};
+    bestMove = BoardSymmetry::unmapDirection(symmetry, directions[(*found >> MOVE_SHIFT) & 3]);
+    winProbability = double(*found & PROBABILITY_MASK) / PROBABILITY_MASK;
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef ENDGAMETABLEBASE_H_INCLUDED
+#define ENDGAMETABLEBASE_H_INCLUDED
+
+#include "PackedBoard.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <ostream>
+
+using namespace std;
+
+/**
+ * @class EndgameTablebase
+ * @brief Exact win probability and best move of every reachable 3x3 position.
+ *        Merging two tiles of value v leaves one tile of v / 2, so the sum of 1 / v over the
+ *        board never changes on a merge and grows with every spawn. Positions therefore fall
+ *        into levels that play only ever climbs, and the generator solves them from the top
+ *        level down. The file is one sorted array of 64-bit records, one per position up to
+ *        rotation and reflection, and is memory-mapped so probing costs a binary search.
+ */
+class EndgameTablebase
+{
+private:
+    // Record layout: canonical board in the top 36 bits, best move (index into i/j/k/l)
+    // in the next 2, then the win probability as a 26-bit fraction
+    static const int KEY_SHIFT = 28;
+    static const int MOVE_SHIFT = 26;
+    static const uint64_t PROBABILITY_MASK = (1ULL << MOVE_SHIFT) - 1;
+    static const uint64_t FILE_MAGIC = 0x3142543834303252ULL; // "R2048TB1" read little-endian
+    static const uint32_t FILE_VERSION = 1;
+
+    // Start of the file, followed by recordCount records
+    struct FileHeader
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t startNumber;
+        uint64_t recordCount;
+    };
+
+    MappedFile file;          // The mapped tablebase file
+    const uint64_t* records;  // Records sorted by canonical board
+    size_t recordCount;       // Number of records
+
+    EndgameTablebase();
+
+    // Returns the smallest of the eight images of a 3x3 board and the symmetry giving it
+    static uint64_t canonical(uint64_t board, int& symmetry);
+
+public:
+    // Returns the file name the tablebase for a start number is built into and loaded from
+    static string defaultPath(int startNumber);
+
+    // Returns the shared tablebase for a start number, mapping its file on first use;
+    // null if the file does not exist. Throws runtime_error if the file is malformed
+    static shared_ptr<const EndgameTablebase> forNumber(int startNumber);
+
+    // Solves every 3x3 position reachable with a start number (128, 256 or 512) and writes
+    // the tablebase to path, reporting progress to log; returns the number of positions
+    static size_t build(int startNumber, const string& path, ostream& log);
+
+    // Looks a 3x3 board up; false if it is not in the table
+    bool probe(const PackedBoard& b, char& bestMove, double& winProbability) const;
+
+    // Returns the number of positions stored
+    size_t size() const { return recordCount; }
+};
+
+#endif // ENDGAMETABLEBASE_H_INCLUDED
@@ -0,0 +1,167 @@
+#include "EvalTables.h"
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define EVAL_TABLES_X86 1
+#endif
+
+// Constructor
+EvalTables::EvalTables(int size, const EvalWeights& evalWeights)
+    : layout(size), weights(evalWeights), rowWeight(), nibbleOnes(0), useAvx2(false), cellWeight(),
+      tileScore()
+{
+    for (int j = 0; j < size; j++)
+        nibbleOnes |= 1u << (j * 4);
+#ifdef EVAL_TABLES_X86
+    useAvx2 = size == 5 && __builtin_cpu_supports("avx2");
+#endif
+    buildTables();
+}
+
+// Shared tables per (size, weights). The latest tables of each size stay alive so AIs that are
+// created one after another do not rebuild them; others go away with their last user
+shared_ptr<const EvalTables> EvalTables::forSettings(int size, const EvalWeights& evalWeights)
+{
+    static mutex registryMutex;
+    static map<pair<int, EvalWeights>, weak_ptr<const EvalTables>> registry;
+    static shared_ptr<const EvalTables> latest[6];
+
+    lock_guard<mutex> lock(registryMutex);
+    auto& entry = registry[make_pair(size, evalWeights)];
+    shared_ptr<const EvalTables> tables = entry.lock();
+    if (!tables)
+    {
+        tables.reset(new EvalTables(size, evalWeights));
+        entry = tables;
+    }
+    if (size >= 0 && size < 6)
+        latest[size] = tables;
+    return tables;
+}
+
+// Score every possible row. The weight of cell (i, j) is decay^(distance from the bottom-right
+// corner), which splits into a column part kept in the row table and a row part applied per row
+void EvalTables::buildTables()
+{
+    const int n = layout.size();
+    for (int i = 0; i < n; i++)
+        rowWeight[i] = pow(weights.decay, n - 1 - i);
+
+    double columnWeight[5];
+    for (int j = 0; j < n; j++)
+        columnWeight[j] = pow(weights.decay, n - 1 - j);
+
+    for (int cell = 0; cell < n * n; cell++)
+        for (int code = 1; code < 16; code++)
+            tileScore[cell][code] = (weights.tile / (1 << (code - 1))) * (rowWeight[cell / n] * columnWeight[cell % n]);
+
+    if (useAvx2)
+    {
+        // The vector path needs only the weight of each cell
+        for (int cell = 0; cell < n * n; cell++)
+            cellWeight[cell] = rowWeight[cell / n] * columnWeight[cell % n];
+        return;
+    }
+
+    const uint32_t rowCount = 1u << (n * 4);
+    rowScore.assign(rowCount, 0.0);
+    rowInfo.assign(rowCount, 0);
+    for (uint32_t row = 0; row < rowCount; row++)
+    {
+        double score = 0.0;
+        int emptyCells = 0, merges = 0;
+        bool win = false;
+        for (int j = 0; j < n; j++)
+        {
+            int code = (row >> (j * 4)) & 0xF;
+            if (code == 0)
+            {
+                emptyCells++;
+                continue;
+            }
+            //SCORE: The most important line of code
+            score += (weights.tile / (1 << (code - 1))) * columnWeight[j]; // Prefer smaller values with position-based weighting
+            if (j < n - 1 && code == int((row >> ((j + 1) * 4)) & 0xF))
+                merges++;
+            if (code == 1)
+                win = true;
+        }
+        rowScore[row] = score;
+        rowInfo[row] = emptyCells | (merges << 3) | (win ? WIN_FLAG : 0);
+    }
+}
+
+// Score a board with one table lookup per row
+double EvalTables::evaluate(const PackedBoard& b) const
+{
+    return withBoardSize(layout.size(), [&](auto size)
+    {
+        return evaluate<decltype(size)::value>(b);
+    });
+}
+
+#ifdef EVAL_TABLES_X86
+// One pass over a 5x5 board: lo holds cells 0-14 and hi cells 15-24, one nibble each
+__attribute__((target("avx2")))
+double EvalTables::evaluateAvx2(const PackedBoard& b) const
+{
+    // Spread both words to one byte per nibble, then join them into cells 0-24 in order
+    const __m128i lowNibbles = _mm_set1_epi8(0x0F);
+    __m128i lo = _mm_cvtsi64_si128(int64_t(b.lo));
+    __m128i hi = _mm_cvtsi64_si128(int64_t(b.hi));
+    __m128i loBytes = _mm_unpacklo_epi8(_mm_and_si128(lo, lowNibbles),
+                                        _mm_and_si128(_mm_srli_epi16(lo, 4), lowNibbles));
+    __m128i hiBytes = _mm_unpacklo_epi8(_mm_and_si128(hi, lowNibbles),
+                                        _mm_and_si128(_mm_srli_epi16(hi, 4), lowNibbles));
+    __m128i firstHalf = _mm_or_si128(loBytes, _mm_slli_si128(hiBytes, 15));
+    __m256i cells = _mm256_inserti128_si256(_mm256_castsi128_si256(firstHalf),
+                                            _mm_srli_si128(hiBytes, 1), 1);
+
+    const uint32_t allCells = (1u << 25) - 1;
+    const uint32_t hasRight = 0x0F * (1u | 1u << 5 | 1u << 10 | 1u << 15 | 1u << 20);
+    const uint32_t hasBelow = (1u << 20) - 1;
+    uint32_t wins = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, _mm256_set1_epi8(1)))) & allCells;
+    if (wins != 0) return DBL_MAX;
+    uint32_t empty = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, _mm256_setzero_si256()))) & allCells;
+
+    // Neighbours to the right and below are the same vector shifted by 1 and 5 bytes
+    __m256i upperLane = _mm256_permute2x128_si256(cells, cells, 0x81);
+    __m256i right = _mm256_alignr_epi8(upperLane, cells, 1);
+    __m256i below = _mm256_alignr_epi8(upperLane, cells, 5);
+    uint32_t sameRight = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, right))) & ~empty & hasRight;
+    uint32_t sameBelow = uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(cells, below))) & ~empty & hasBelow;
+
+    // tile / 2^(code - 1) is built directly as the double tile * 2^(1 - code)
+    alignas(32) uint8_t codes[32];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(codes), cells);
+    __m256d score = _mm256_setzero_pd();
+    const __m256i exponentBase = _mm256_set1_epi64x(1024);
+    const __m256d tileWeight = _mm256_set1_pd(weights.tile);
+    for (int cell = 0; cell < 28; cell += 4)
+    {
+        int32_t four;
+        memcpy(&four, codes + cell, 4);
+        __m256i code = _mm256_cvtepu8_epi64(_mm_cvtsi32_si128(four));
+        __m256d reciprocal = _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_sub_epi64(exponentBase, code), 52));
+        __m256d occupied = _mm256_castsi256_pd(_mm256_cmpgt_epi64(code, _mm256_setzero_si256()));
+        __m256d term = _mm256_mul_pd(_mm256_mul_pd(tileWeight, reciprocal), _mm256_load_pd(cellWeight + cell));
+        score = _mm256_add_pd(score, _mm256_and_pd(term, occupied));
+    }
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(score), _mm256_extractf128_pd(score, 1));
+    double weighted = _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+
+    int emptyCells = __builtin_popcount(empty);
+    int mergeOpportunities = __builtin_popcount(sameRight) + __builtin_popcount(sameBelow);
+    return weighted + (weights.empty * emptyCells) + (weights.merge * mergeOpportunities);
+}
+#else
+// Without x86 vector instructions useAvx2 is never set
+double EvalTables::evaluateAvx2(const PackedBoard& b) const
+{
+    return evaluateRows<5>(b);
+}
+#endif
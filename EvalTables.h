@@ -0,0 +1,126 @@
+#ifndef EVALTABLES_H_INCLUDED
+#define EVALTABLES_H_INCLUDED
+
+#include "PackedBoard.h"
+#include "Board.h"
+#include "EvalWeights.h"
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <cfloat>
+
+using namespace std;
+
+/**
+ * @class EvalTables
+ * @brief Table-driven board evaluation for packed boards.
+ *        Every possible row is scored once when the tables are built, so a leaf is scored
+ *        with one lookup per row plus a few bit operations for the merges between rows.
+ *        On CPUs with AVX2, 5x5 boards skip the (large) tables and are scored in one
+ *        vector pass over the cells unpacked to bytes.
+ */
+class EvalTables
+{
+private:
+    static const uint8_t WIN_FLAG = 0x80; // Row info bit set when the row holds the winning 1
+
+    BoardLayout layout;           // Cell layout of the boards being scored
+    EvalWeights weights;          // Weights the tables were built with
+    vector<double> rowScore;      // Position-weighted reciprocal score of a row, as if it were the last row
+    vector<uint8_t> rowInfo;      // Empty cells (bits 0-2), merges inside the row (bits 3-5) and WIN_FLAG
+    double rowWeight[5];          // Extra position weight of each row
+    uint32_t nibbleOnes;          // 0x1 in every nibble of a row
+    bool useAvx2;                 // Whether 5x5 boards are scored by evaluateAvx2
+    alignas(32) double cellWeight[28]; // Position weight of each cell of a 5x5 board, 0 past the last cell
+    double tileScore[25][16];     // Weighted reciprocal score of each code on each cell
+
+    // Fills the tables for every possible row
+    void buildTables();
+
+    // Scores a 5x5 board with AVX2: empty cells, win, equal neighbours and the weighted
+    // score all come from the 25 cells unpacked into one 32-byte vector
+    double evaluateAvx2(const PackedBoard& b) const;
+
+    // Counts columns where two rows hold the same non-empty code
+    int mergesBetween(uint32_t upper, uint32_t lower) const
+    {
+        uint32_t same = upper ^ lower;
+        same |= same >> 1;
+        same |= same >> 2;
+        uint32_t occupied = upper | upper >> 1;
+        occupied |= occupied >> 2;
+        return __builtin_popcount(~same & occupied & nibbleOnes);
+    }
+
+    // Builds the tables for a grid size and evaluation weights
+    EvalTables(int size, const EvalWeights& evalWeights);
+
+public:
+    // Returns shared tables for a grid size and evaluation weights, building them on first use
+    static shared_ptr<const EvalTables> forSettings(int size, const EvalWeights& evalWeights);
+
+    // Returns the weights the tables were built with
+    const EvalWeights& getWeights() const { return weights; }
+
+    // Scores a board: weighted reciprocal tile values, empty cells and merge opportunities
+    double evaluate(const PackedBoard& b) const;
+
+    // Same score with the grid size fixed at compile time
+    template <int N>
+    double evaluate(const PackedBoard& b) const
+    {
+        if (N == 5 && useAvx2)
+            return evaluateAvx2(b);
+        return evaluateRows<N>(b);
+    }
+
+    // Scores every board a spawn can turn b into, in cell order then code order. A spawn
+    // changes the score by one tile term, one empty cell and the equal neighbours it gains,
+    // so b itself is scored once and each outcome costs a few additions
+    template <int N>
+    void evaluateSpawns(const PackedBoard& b, uint32_t emptyCells, const vector<int>& codes,
+                        double* values) const
+    {
+        double base = evaluate<N>(b) - weights.empty;
+        int k = 0;
+        for (uint32_t cells = emptyCells; cells != 0; cells &= cells - 1)
+        {
+            int cell = __builtin_ctz(cells);
+            int col = cell % N;
+            int left = col > 0 ? Board<N>::getCell(b, cell - 1) : 0;
+            int right = col < N - 1 ? Board<N>::getCell(b, cell + 1) : 0;
+            int up = cell >= N ? Board<N>::getCell(b, cell - N) : 0;
+            int down = cell < N * (N - 1) ? Board<N>::getCell(b, cell + N) : 0;
+            for (int code : codes)
+            {
+                int sameNeighbours = (left == code) + (right == code) + (up == code) + (down == code);
+                values[k++] = code == 1 ? DBL_MAX : base + tileScore[cell][code] + weights.merge * sameNeighbours;
+            }
+        }
+    }
+
+    // Table-driven score, used when the vector path is not
+    template <int N>
+    double evaluateRows(const PackedBoard& b) const
+    {
+        double score = 0.0;
+        int emptyCells = 0, mergeOpportunities = 0;
+        uint32_t previous = 0;
+        for (int i = 0; i < N; i++)
+        {
+            uint32_t row = Board<N>::getRow(b, i);
+            uint8_t info = rowInfo[row];
+            if (info & WIN_FLAG) return DBL_MAX;
+
+            score += rowScore[row] * rowWeight[i];
+            emptyCells += info & 0x7;
+            mergeOpportunities += (info >> 3) & 0x7;
+            if (i > 0)
+                mergeOpportunities += mergesBetween(previous, row);
+            previous = row;
+        }
+        return score + (weights.empty * emptyCells) + (weights.merge * mergeOpportunities);
+    }
+};
+
+#endif // EVALTABLES_H_INCLUDED
@@ -0,0 +1,154 @@
+#include "EvalTuner.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+// Weight change of one tuned unit: ln empty, ln merge, decay
+static const double THETA_SCALES[3] = {0.5, 0.5, 0.1};
+
+// SPSA gains: step a / (k + 1 + A)^0.602 and perturbation c / (k + 1)^0.101, the usual exponents.
+// A win rate difference of 0.05 steps about a quarter unit in the first iterations
+static const double STEP_GAIN = 10.0;
+static const double STEP_STABILITY = 10.0;
+static const double PERTURBATION = 1.0;
+
+// Decay is kept where the position weight still falls towards the far corner
+static const double MIN_DECAY = 0.05;
+static const double MAX_DECAY = 1.0;
+
+// Constructor
+EvalTuner::EvalTuner(const TunerConfig& config) : config(config), runner(config.threads) {
+    if (config.games <= 0) throw invalid_argument("Games must be positive");
+}
+
+// Logarithms for the positive weights, so a step scales them; parseWeights keeps them positive
+EvalTuner::Theta EvalTuner::toTheta(const EvalWeights& weights) {
+    return {log(weights.empty) / THETA_SCALES[0], log(weights.merge) / THETA_SCALES[1],
+            weights.decay / THETA_SCALES[2]};
+}
+
+// Inverse of toTheta, with the decay clamped to its range
+EvalWeights EvalTuner::toWeights(const Theta& theta) {
+    EvalWeights weights;
+    weights.empty = exp(theta[0] * THETA_SCALES[0]);
+    weights.merge = exp(theta[1] * THETA_SCALES[1]);
+    weights.decay = min(MAX_DECAY, max(MIN_DECAY, theta[2] * THETA_SCALES[2]));
+    return weights;
+}
+
+// Every candidate of an iteration plays the same seeds
+double EvalTuner::winRate(const EvalWeights& weights, int iteration) const {
+    SearchSettings search;
+    search.depth = config.depth;
+    search.weights = weights;
+    BatchConfig batch = {config.gridSize, config.startNumber, AiType::Expectimax, config.games,
+                         config.seed + unsigned(iteration) * unsigned(config.games), "", search};
+    return runner.run(batch).winRate();
+}
+
+// The checkpoint is a text file of name value lines
+bool EvalTuner::loadCheckpoint(int& iteration, Theta& theta) const {
+    if (config.checkpointPath.empty()) return false;
+    ifstream in(config.checkpointPath);
+    if (!in) return false;
+
+    auto field = [&](const string& name) {
+        string key;
+        double value;
+        if (!(in >> key >> value) || key != name)
+            throw runtime_error("Malformed tuner checkpoint file: " + config.checkpointPath);
+        return value;
+    };
+    if (int(field("size")) != config.gridSize || int(field("number")) != config.startNumber ||
+        int(field("depth")) != config.depth || int(field("games")) != config.games ||
+        unsigned(field("seed")) != config.seed)
+        throw invalid_argument("Tuner checkpoint " + config.checkpointPath + " was made with other settings");
+    iteration = int(field("iteration"));
+    theta[0] = field("empty");
+    theta[1] = field("merge");
+    theta[2] = field("decay");
+    return true;
+}
+
+// Write beside the old checkpoint and swap it in, so an interrupted write loses nothing
+void EvalTuner::saveCheckpoint(int iteration, const Theta& theta) const {
+    if (config.checkpointPath.empty()) return;
+    string temporaryPath = config.checkpointPath + ".tmp";
+    ofstream out(temporaryPath);
+    out << setprecision(17)
+        << "size " << config.gridSize << "\nnumber " << config.startNumber << "\ndepth " << config.depth
+        << "\ngames " << config.games << "\nseed " << config.seed << "\niteration " << iteration
+        << "\nempty " << theta[0] << "\nmerge " << theta[1] << "\ndecay " << theta[2] << "\n";
+    out.close();
+    if (!out)
+        throw runtime_error("Cannot write tuner checkpoint file: " + temporaryPath);
+    remove(config.checkpointPath.c_str());
+    if (rename(temporaryPath.c_str(), config.checkpointPath.c_str()) != 0)
+        throw runtime_error("Cannot write tuner checkpoint file: " + config.checkpointPath);
+}
+
+// SPSA ascent on the win rate
+EvalWeights EvalTuner::run(ostream& log) {
+    int iteration = 0;
+    Theta theta = toTheta(EvalWeights());
+    if (loadCheckpoint(iteration, theta)) {
+        log << "Resuming at iteration " << iteration << " from " << config.checkpointPath
+            << ", weights " << formatWeights(toWeights(theta)) << endl;
+    }
+
+    for (; iteration < config.iterations; iteration++) {
+        double step = STEP_GAIN / pow(iteration + 1 + STEP_STABILITY, 0.602);
+        double perturbation = PERTURBATION / pow(iteration + 1, 0.101);
+
+        // Each weight moves up or down by the perturbation, independently
+        mt19937 rng(config.seed + unsigned(iteration));
+        bernoulli_distribution coin(0.5);
+        Theta delta, plus, minus;
+        for (size_t i = 0; i < theta.size(); i++) {
+            delta[i] = coin(rng) ? 1.0 : -1.0;
+            plus[i] = theta[i] + perturbation * delta[i];
+            minus[i] = theta[i] - perturbation * delta[i];
+        }
+
+        double plusRate = winRate(toWeights(plus), iteration);
+        double minusRate = winRate(toWeights(minus), iteration);
+        for (size_t i = 0; i < theta.size(); i++) {
+            theta[i] += step * (plusRate - minusRate) / (2.0 * perturbation * delta[i]);
+        }
+        theta = toTheta(toWeights(theta)); // Keep the decay inside its range
+
+        log << "Iteration " << iteration + 1 << ": win rate " << plusRate << " / " << minusRate
+            << ", weights " << formatWeights(toWeights(theta)) << endl;
+        saveCheckpoint(iteration + 1, theta);
+    }
+    return toWeights(theta);
+}
+
+// Weights as a --weights option value; 17 digits read back to the same doubles, which the
+// opening book and the search cache compare exactly
+string EvalTuner::formatWeights(const EvalWeights& weights) {
+    stringstream out;
+    out << setprecision(17) << weights.tile << ',' << weights.empty << ',' << weights.merge << ',' << weights.decay;
+    return out.str();
+}
+
+// Four comma separated numbers
+EvalWeights EvalTuner::parseWeights(const string& text) {
+    stringstream in(text);
+    EvalWeights weights;
+    char comma1 = 0, comma2 = 0, comma3 = 0;
+    in >> weights.tile >> comma1 >> weights.empty >> comma2 >> weights.merge >> comma3 >> weights.decay;
+    if (!in || comma1 != ',' || comma2 != ',' || comma3 != ',' || !(in >> ws).eof())
+        throw invalid_argument("Weights must be tile,empty,merge,decay: " + text);
+    if (!isfinite(weights.tile) || !isfinite(weights.empty) || !isfinite(weights.merge) || !isfinite(weights.decay))
+        throw invalid_argument("Weights must be finite: " + text);
+    if (weights.tile <= 0 || weights.empty <= 0 || weights.merge <= 0)
+        throw invalid_argument("Tile, empty and merge weights must be positive: " + text);
+    if (weights.decay < MIN_DECAY || weights.decay > MAX_DECAY)
+        throw invalid_argument("Decay must be between 0.05 and 1: " + text);
+    return weights;
+}
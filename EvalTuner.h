@@ -0,0 +1,71 @@
+#ifndef EVALTUNER_H_INCLUDED
+#define EVALTUNER_H_INCLUDED
+
+#include "BatchRunner.h"
+#include "EvalWeights.h"
+#include <array>
+#include <string>
+#include <ostream>
+
+using namespace std;
+
+// What the tuner plays and for how long
+struct TunerConfig {
+    int gridSize;
+    int startNumber;
+    int depth;
+    int games;       // Games per candidate and iteration
+    int iterations;  // Iterations to reach, counting those of a resumed run
+    unsigned seed;   // Iteration k plays seeds from seed + k * games
+    int threads;     // Games played at the same time, 0 for every core
+    string checkpointPath; // Progress is saved here after every iteration and resumed from, empty for none
+};
+
+/**
+ * @class EvalTuner
+ * @brief Tunes the Expectimax evaluation weights by self-play with SPSA
+ *        (simultaneous perturbation stochastic approximation): every iteration nudges all
+ *        weights at once in a random direction, plays the same seeded games with both signs
+ *        of the nudge and steps towards the side that won more. Two candidates per iteration
+ *        suffice however many weights there are, and the shared seeds cancel most of the luck.
+ *        The tile weight is left alone, because scaling every weight alike never changes a move.
+ */
+class EvalTuner {
+private:
+    typedef array<double, 3> Theta; // ln empty, ln merge and decay, each divided by its scale
+
+    TunerConfig config;
+    BatchRunner runner;
+
+    // Converts between weights and the tuned coordinates
+    static Theta toTheta(const EvalWeights& weights);
+    static EvalWeights toWeights(const Theta& theta);
+
+    // Plays the games of one iteration with some weights; returns the fraction won
+    double winRate(const EvalWeights& weights, int iteration) const;
+
+    // Loads the progress of an earlier run; false if there is no checkpoint.
+    // Throws invalid_argument if it was made with other settings
+    bool loadCheckpoint(int& iteration, Theta& theta) const;
+
+    // Saves the progress after an iteration
+    void saveCheckpoint(int iteration, const Theta& theta) const;
+
+public:
+    // Constructor
+    explicit EvalTuner(const TunerConfig& config);
+
+    // Runs the remaining iterations from the default weights or the checkpoint, reporting
+    // each iteration to log; returns the tuned weights
+    EvalWeights run(ostream& log);
+
+    // Formats weights as tile,empty,merge,decay, with every digit parseWeights needs to read
+    // them back unchanged
+    static string formatWeights(const EvalWeights& weights);
+
+    // Parses weights formatted as tile,empty,merge,decay. Throws invalid_argument if malformed,
+    // not finite, or if the decay is outside the tuner's range
+    static EvalWeights parseWeights(const string& text);
+};
+
+#endif // EVALTUNER_H_INCLUDED
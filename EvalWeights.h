@@ -0,0 +1,26 @@
+#ifndef EVALWEIGHTS_H_INCLUDED
+#define EVALWEIGHTS_H_INCLUDED
+
+// Weights of the terms of ExpectimaxAI's board evaluation
+struct EvalWeights
+{
+    double tile = 1000.0;  // Score of a tile is tile / value, times its position weight
+    double empty = 4.0;    // Score per empty cell
+    double merge = 10.0;   // Score per pair of equal neighbours
+    double decay = 0.5;    // Position weight falls by this factor per step from the bottom-right corner
+
+    bool operator==(const EvalWeights& other) const
+    {
+        return tile == other.tile && empty == other.empty && merge == other.merge && decay == other.decay;
+    }
+    bool operator!=(const EvalWeights& other) const { return !(*this == other); }
+    bool operator<(const EvalWeights& other) const
+    {
+        if (tile != other.tile) return tile < other.tile;
+        if (empty != other.empty) return empty < other.empty;
+        if (merge != other.merge) return merge < other.merge;
+        return decay < other.decay;
+    }
+};
+
+#endif // EVALWEIGHTS_H_INCLUDED
@@ -1,18 +1,6 @@
 #include "ExpectimaxAI.h"
 #include "GridGame.h"
 
-// Initialize direction vectors for movement
-void ExpectimaxAI::initDirectionVectors()
-{
-    dirVectors =
-    {
-        {'i', {-1, 0, 1, gridSize, 1, 0, gridSize, 1}},    // Up
-        {'k', {1, 0, gridSize-2, -1, -1, 0, gridSize, 1}}, // Down
-        {'j', {0, -1, 0, gridSize, 1, 1, gridSize, 1}},    // Left
-        {'l', {0, 1, 0, gridSize, 1, gridSize-2, -1, -1}}  // Right
-    };
-}
-
 // Initialize possible spawn values based on the starting number
 void ExpectimaxAI::initPossibleSpawnValues()
 {
@@ -33,240 +21,323 @@ void ExpectimaxAI::initPossibleSpawnValues()
         // Default case - just use the startNumber
         possibleSpawnValues = {startNumber};
     }
+
+    possibleSpawnCodes.clear();
+    for (int value : possibleSpawnValues)
+        possibleSpawnCodes.push_back(BoardLayout::toCode(value, EMPTY));
 }
 
-// Calculate position weight based on exponential decay from a corner
-double ExpectimaxAI::getPositionWeight(int row, int col) const
+// Simulate a move in the given direction with one table lookup per line
+PackedBoard ExpectimaxAI::simulateMove(const PackedBoard& b, char dir, bool& changed) const
 {
-    // Using bottom-right corner as the preferred position
-    int distanceFromCorner = (gridSize - 1 - row) + (gridSize - 1 - col);
-    return pow(decayFactor, distanceFromCorner);
+    PackedBoard newBoard = moveEngine.move(b, dir);
+    changed = newBoard != b;
+    return newBoard;
 }
 
-// Convert grid to string for caching
-string ExpectimaxAI::gridToString(const vector<vector<int>>& g) const
+// Get all empty cells in the board
+uint32_t ExpectimaxAI::getEmptyCells(const PackedBoard& b) const
 {
-    string result;
-    for (const auto& row : g)
-        for (int val : row)
-            result += to_string(val) + ",";
-    return result;
+    return withBoardSize(gridSize, [&](auto size)
+    {
+        return Board<decltype(size)::value>::emptyCells(b);
+    });
 }
 
-// Check if position is within grid bounds
-bool ExpectimaxAI::isValidPosition(int row, int col) const
+// Check if the board has a value of 1 (win condition)
+bool ExpectimaxAI::hasValueOne(const PackedBoard& b) const
 {
-    return row >= 0 && row < gridSize && col >= 0 && col < gridSize;
+    return withBoardSize(gridSize, [&](auto size)
+    {
+        return Board<decltype(size)::value>::hasValueOne(b);
+    });
 }
 
-// Check if a move in the given direction is possible
-bool ExpectimaxAI::tryMove(const vector<vector<int>>& g, char dir) const
+// Check if the game is over (no valid moves)
+bool ExpectimaxAI::checkGameOver(const PackedBoard& b) const
 {
-    const auto& dv = dirVectors.at(dir);
-    for (int i = dv.startRow; i != dv.endRow; i += dv.rowStep)
+    return withBoardSize(gridSize, [&](auto size)
     {
-        for (int j = dv.startCol; j != dv.endCol; j += dv.colStep)
-        {
-            if (g[i][j] != EMPTY)
-            {
-                int ni = i + dv.rowDelta, nj = j + dv.colDelta;
-                if (isValidPosition(ni, nj) && (g[ni][nj] == EMPTY || g[ni][nj] == g[i][j]))
-                    return true;
-            }
-        }
+        return Board<decltype(size)::value>::isGameOver(b);
+    });
+}
+
+// Evaluate the board state with the precomputed row tables
+double ExpectimaxAI::evaluateGrid(const PackedBoard& b) const
+{
+    return evalTables->evaluate(b);
+}
+
+// Memory first, then the mapped file of earlier runs. Under a cutoff a value is only taken if
+// pathProb * 2^-exponent stays above it, so nothing below would have been cut on this path
+bool ExpectimaxAI::probeCaches(uint64_t key, int depth, TranspositionTable::NodeType type, double pathProb,
+                               double& value, double& reach, SearchCounters& stats)
+{
+    stats.cacheProbes++;
+    int maxReachExponent = INT_MAX;
+    if (probabilityCutoff > 0.0)
+        maxReachExponent = pathProb < probabilityCutoff ? -1 : int(floor(log2(pathProb / probabilityCutoff)));
+    int reachExponent;
+    if (evalCache.probe(key, depth, type, maxReachExponent, value, reachExponent))
+    {
+        stats.cacheHits++;
+        reach = ldexp(1.0, -reachExponent);
+        return true;
+    }
+    if (persistentCache && depth >= PersistentCache::MIN_DEPTH &&
+        persistentCache->probe(key, depth, type, value))
+    {
+        stats.cacheHits++;
+        stats.persistentCacheHits++;
+        evalCache.store(key, depth, type, value);
+        reach = 1.0;
+        return true;
     }
     return false;
 }
 
-// Simulate a move in the given direction
-vector<vector<int>> ExpectimaxAI::simulateMove(const vector<vector<int>>& g, char dir) const
+// A cut anywhere below leaves a value that only holds for this path; those are not cached
+void ExpectimaxAI::storeValue(uint64_t key, int depth, TranspositionTable::NodeType type, double value,
+                              double pathProb, double reach, SearchCounters& stats)
 {
-    vector<vector<int>> newGrid = g;
-    const auto& dv = dirVectors.at(dir);
+    if (stopSearch || pathProb * reach < probabilityCutoff) return;
+    int reachExponent = probabilityCutoff > 0.0 ? TranspositionTable::reachExponent(reach) : 0;
+    stats.cacheStores++;
+    stats.cacheEvictions += evalCache.store(key, depth, type, value, reachExponent);
+}
 
-    for (int i = dv.startRow; i != dv.endRow; i += dv.rowStep)
+// Expectimax algorithm implementation, shared by the copying and the in-place search
+template <int N, typename Node>
+double ExpectimaxAI::expectimax(Node& node, int depth, bool isMaxPlayer, double pathProb, double& reach)
+{
+    reach = DBL_MAX; // Leaves check no cutoff
+    if (searchStopped()) return 0.0;
+    SearchCounters& stats = threadCounters();
+    int statsDepth = min(depth, MAX_STATS_DEPTH - 1);
+    if (isMaxPlayer)
+        stats.maxNodes[statsDepth]++;
+    else
+        stats.chanceNodes[statsDepth]++;
+
+    // Check cache; symmetric boards have the same value and share one entry
+    const PackedBoard& b = node.board;
+    auto nodeType = isMaxPlayer ? TranspositionTable::MAX_NODE : TranspositionTable::CHANCE_NODE;
+    uint64_t key = symmetry.canonical(node.hash);
+    double cached;
+    if (probeCaches(key, depth, nodeType, pathProb, cached, reach, stats))
+        return cached;
+
+    // Terminal conditions
+    if (Board<N>::hasValueOne(b)) return DBL_MAX;
+    if (depth == 0 || !Board<N>::canMove(b))
+        return evaluateLeaf<N>(b);
+    reach = 1.0;
+
+    // Unlikely line: score it statically instead of searching it out. Values whose subtree
+    // was cut are only cached with the reach that lets a probe tell whether they apply
+    if (pathProb < probabilityCutoff)
     {
-        for (int j = dv.startCol; j != dv.endCol; j += dv.colStep)
-        {
-            if (newGrid[i][j] == EMPTY) continue;
+        stats.prunedNodes++;
+        return evaluateLeaf<N>(b);
+    }
 
-            int ni = i, nj = j;
-            while (true)
+    double result;
+    if (isMaxPlayer)
+    {
+        result = -DBL_MAX;
+        for (char dir : {'i', 'j', 'k', 'l'})
+        {
+            visitMove<N>(node, dir, [&](auto& child)
             {
-                int next_i = ni + dv.rowDelta, next_j = nj + dv.colDelta;
-                if (!isValidPosition(next_i, next_j)) break;
+                double childReach;
+                result = max(result, expectimax<N>(child, depth - 1, false, pathProb, childReach));
+                reach = min(reach, childReach);
+            });
+        }
+        if (result == -DBL_MAX)
+            result = evaluateLeaf<N>(b);
+    }
+    else
+    {
+        // Chance node - now considering multiple possible spawn values
+        uint32_t emptyCells = Board<N>::emptyCells(b);
+        if (emptyCells == 0)
+        {
+            double value = expectimax<N>(node, depth - 1, true, pathProb, reach);
+            reach = min(reach, 1.0);
+            return value;
+        }
 
-                if (newGrid[next_i][next_j] == EMPTY)
-                {
-                    ni = next_i;
-                    nj = next_j;
-                }
-                else if (newGrid[next_i][next_j] == newGrid[i][j])
-                {
-                    ni = next_i;
-                    nj = next_j;
-                    break;
-                }
-                else
-                {
-                    break;
-                }
-            }
+        result = 0.0;
+        double cellProb = 1.0 / __builtin_popcount(emptyCells);
+        double valueProb = 1.0 / possibleSpawnCodes.size();
 
-            if (ni != i || nj != j)
+        double childProb = cellProb * valueProb;
+        if (depth == 1)
+        {
+            // Every child is a leaf (leaves are never cached), so score them all in one pass.
+            // Chance nodes sit at odd remaining depths only in even-depth searches; an odd-depth
+            // search such as the default 7 ends its lines in chance nodes with no ply left, which
+            // are scored as the moved board without spawns, so it only gets here in the even
+            // iterations of a time-budgeted search
+            double leafValues[25 * 16];
+            int children = __builtin_popcount(emptyCells) * int(possibleSpawnCodes.size());
+            evalTables->evaluateSpawns<N>(b, emptyCells, possibleSpawnCodes, leafValues);
+            stats.maxNodes[0] += children;
+            stats.leafEvaluations += children;
+            for (int k = 0; k < children; k++)
+                result += childProb * leafValues[k];
+        }
+        else if (pool && depth >= parallelCutoff)
+        {
+            return parallelChance<N>(b, node.hash, depth, emptyCells, childProb, pathProb, reach);
+        }
+        else
+        {
+            // For each empty cell and each possible value
+            for (uint32_t cells = emptyCells; cells != 0; cells &= cells - 1)
             {
-                if (newGrid[ni][nj] == newGrid[i][j])
-                    newGrid[ni][nj] /= 2;  // Merge by division
-                else
-                    newGrid[ni][nj] = newGrid[i][j];
-                newGrid[i][j] = EMPTY;
+                int cell = __builtin_ctz(cells);
+                for (int code : possibleSpawnCodes)
+                {
+                    visitSpawn<N>(node, cell, code, [&](auto& child)
+                    {
+                        double childReach;
+                        result += childProb * expectimax<N>(child, depth - 1, true, pathProb * childProb,
+                                                            childReach);
+                        reach = min(reach, childProb * childReach);
+                    });
+                }
             }
         }
     }
-    return newGrid;
+
+    // A stopped search leaves partial sums behind, those must not be cached
+    storeValue(key, depth, nodeType, result, pathProb, reach, stats);
+    return result;
 }
 
-// Get all empty cells in the grid
-vector<Position> ExpectimaxAI::getEmptyCells(const vector<vector<int>>& g) const
+// Copying search: each child gets its own board and hashes
+template <int N, typename Visit>
+bool ExpectimaxAI::visitMove(const SearchBoard& node, char dir, Visit visit)
 {
-    vector<Position> emptyCells;
-    for (int i = 0; i < gridSize; i++)
-        for (int j = 0; j < gridSize; j++)
-            if (g[i][j] == EMPTY)
-                emptyCells.push_back({i, j});
-    return emptyCells;
+    SearchBoard child;
+    child.board = moveEngine.move<N>(node.board, dir);
+    if (child.board == node.board) return false;
+    child.hash = node.hash;
+    symmetry.update(child.hash, node.board, child.board);
+    visit(child);
+    return true;
 }
 
-// Check if the grid has a value of 1 (win condition)
-bool ExpectimaxAI::hasValueOne(const vector<vector<int>>& g) const
+template <int N, typename Visit>
+void ExpectimaxAI::visitSpawn(const SearchBoard& node, int cell, int code, Visit visit)
 {
-    for (int i = 0; i < gridSize; i++)
-        for (int j = 0; j < gridSize; j++)
-            if (g[i][j] == 1)
-                return true;
-    return false;
+    SearchBoard child = node;
+    Board<N>::placeTile(child.board, cell, code);
+    symmetry.place(child.hash, cell, code);
+    visit(child);
 }
 
-// Check if the game is over (no valid moves)
-bool ExpectimaxAI::checkGameOver(const vector<vector<int>>& g) const
+// In-place search: the move is made on the working board and undone after the visit
+template <int N, typename Visit>
+bool ExpectimaxAI::visitMove(WorkingBoard& node, char dir, Visit visit)
 {
-    if (hasValueOne(g)) return true;
+    if (!makeMove<N>(node, dir)) return false;
+    visit(node);
+    unmakeMove(node);
+    return true;
+}
 
-    // Check for empty cells
-    for (int i = 0; i < gridSize; i++)
-        for (int j = 0; j < gridSize; j++)
-            if (g[i][j] == EMPTY)
-                return false;
+// Place the spawn, visit, and take it away again; toggling the same key twice restores the hashes
+template <int N, typename Visit>
+void ExpectimaxAI::visitSpawn(WorkingBoard& node, int cell, int code, Visit visit)
+{
+    Board<N>::placeTile(node.board, cell, code);
+    symmetry.place(node.hash, cell, code);
+    visit(node);
+    Board<N>::clearTile(node.board, cell);
+    symmetry.place(node.hash, cell, code);
+}
 
-    // Check for possible merges
-    for (int i = 0; i < gridSize; i++)
-    {
-        for (int j = 0; j < gridSize; j++)
-        {
-            if ((j < gridSize - 1 && g[i][j] == g[i][j+1]) ||
-                    (i < gridSize - 1 && g[i][j] == g[i+1][j]))
-                return false;
-        }
-    }
+// Make a move in place
+template <int N>
+bool ExpectimaxAI::makeMove(WorkingBoard& w, char dir)
+{
+    PackedBoard newBoard = moveEngine.move<N>(w.board, dir);
+    if (newBoard == w.board) return false;
+    w.undoLog[w.undoTop++] = w.board;
+    symmetry.update(w.hash, w.board, newBoard);
+    w.board = newBoard;
     return true;
 }
 
-// Evaluate the grid state
-double ExpectimaxAI::evaluateGrid(const vector<vector<int>>& g) const
+// Undo the last move; updating the hashes from the new board back to the old one reverses them
+void ExpectimaxAI::unmakeMove(WorkingBoard& w)
 {
-    if (hasValueOne(g)) return DBL_MAX;
-
-    double score = 0.0;
-    int emptyCells = 0;
-    double mergeOpportunities = 0.0;
-    int minValue = INT_MAX;
+    PackedBoard previous = w.undoLog[--w.undoTop];
+    symmetry.update(w.hash, w.board, previous);
+    w.board = previous;
+}
 
-    for (int i = 0; i < gridSize; i++)
+// Child search in the selected mode
+template <int N>
+double ExpectimaxAI::searchChild(const PackedBoard& b, const SymmetricHash& hash, int depth,
+                                 bool isMaxPlayer, double pathProb, double& reach)
+{
+    if (!inPlaceSearch)
     {
-        for (int j = 0; j < gridSize; j++)
-        {
-            if (g[i][j] == EMPTY)
-            {
-                emptyCells++;
-            }
-            else
-            {
-                // Apply position weight with exponential decay
-                double positionWeight = getPositionWeight(i, j);
-
-                //SCORE: The most important line of code
-                score += (1000.0 / g[i][j]) * positionWeight; // Prefer smaller values with position-based weighting
-
-                // Track minimum value
-                if (g[i][j] < minValue)
-                    minValue = g[i][j];
-
-                // Count merge opportunities
-                if (j < gridSize - 1 && g[i][j] == g[i][j+1])
-                    mergeOpportunities += 1.0;
-                if (i < gridSize - 1 && g[i][j] == g[i+1][j])
-                    mergeOpportunities += 1.0;
-            }
-        }
+        SearchBoard node = {b, hash};
+        return expectimax<N>(node, depth, isMaxPlayer, pathProb, reach);
     }
-
-    return score + (4 * emptyCells) + (10.0 * mergeOpportunities);
+    WorkingBoard w;
+    w.board = b;
+    w.hash = hash;
+    w.undoTop = 0;
+    return expectimax<N>(w, depth, isMaxPlayer, pathProb, reach);
 }
 
-// Expectimax algorithm implementation
-double ExpectimaxAI::expectimax(const vector<vector<int>>& g, int depth, bool isMaxPlayer)
+// Chance node whose children run as stealable tasks
+template <int N>
+double ExpectimaxAI::parallelChance(const PackedBoard& b, const SymmetricHash& hash, int depth,
+                                    uint32_t emptyCells, double childProb, double pathProb, double& reach)
 {
-    // Check cache
-    string cacheKey = gridToString(g) + to_string(depth) + (isMaxPlayer ? "m" : "c");
-    if (evalCache.find(cacheKey) != evalCache.end())
-        return evalCache[cacheKey];
-
-    // Terminal conditions
-    if (hasValueOne(g)) return DBL_MAX;
-    if (depth == 0 || checkGameOver(g))
-        return evaluateGrid(g);
-
-    double result;
-    if (isMaxPlayer)
+    double childValues[25 * 3];
+    double childReaches[25 * 3];
+    ThreadPool::TaskGroup group;
+    int children = 0;
+    for (uint32_t cells = emptyCells; cells != 0; cells &= cells - 1)
     {
-        result = -DBL_MAX;
-        for (char dir :
-                {'i', 'j', 'k', 'l'
-                })
+        int cell = __builtin_ctz(cells);
+        for (int code : possibleSpawnCodes)
         {
-            if (tryMove(g, dir))
+            auto newBoard = b;
+            Board<N>::placeTile(newBoard, cell, code);
+            SymmetricHash newHash = hash;
+            symmetry.place(newHash, cell, code);
+            double* slot = &childValues[children];
+            double* reachSlot = &childReaches[children++];
+            double childPath = pathProb * childProb;
+            pool->spawn(group, [this, newBoard, newHash, depth, slot, reachSlot, childPath]
             {
-                auto newGrid = simulateMove(g, dir);
-                result = max(result, expectimax(newGrid, depth - 1, false));
-            }
+                *slot = searchChild<N>(newBoard, newHash, depth - 1, true, childPath, *reachSlot);
+            });
         }
-        if (result == -DBL_MAX)
-            result = evaluateGrid(g);
     }
-    else
-    {
-        // Chance node - now considering multiple possible spawn values
-        auto emptyCells = getEmptyCells(g);
-        if (emptyCells.empty())
-            return expectimax(g, depth - 1, true);
+    pool->wait(group);
 
-        result = 0.0;
-        double cellProb = 1.0 / emptyCells.size();
-        double valueProb = 1.0 / possibleSpawnValues.size();
-
-        // For each empty cell and each possible value
-        for (const auto& pos : emptyCells)
-        {
-            for (int value : possibleSpawnValues)
-            {
-                auto newGrid = g;
-                newGrid[pos.row][pos.col] = value;
-                result += cellProb * valueProb * expectimax(newGrid, depth - 1, true);
-            }
-        }
+    // Sum in the same order as the sequential loop so both give identical values
+    double result = 0.0;
+    reach = 1.0;
+    for (int k = 0; k < children; k++)
+    {
+        result += childProb * childValues[k];
+        reach = min(reach, childProb * childReaches[k]);
     }
 
-    evalCache[cacheKey] = result;
+    // The children may have run on other threads, so look the counters up again
+    storeValue(symmetry.canonical(hash), depth, TranspositionTable::CHANCE_NODE, result, pathProb, reach,
+               threadCounters());
     return result;
 }
 
@@ -274,51 +345,498 @@ double ExpectimaxAI::expectimax(const vector<vector<int>>& g, int depth, bool is
 ExpectimaxAI::ExpectimaxAI(vector<vector<int>>& g, Position& pos, int size,
                            int initialNumber, int depth, int empty)
     : grid(g), position(pos), gridSize(size), maxDepth(depth),
-      EMPTY(empty), startNumber(initialNumber)
+      EMPTY(empty), layout(size), moveEngine(MoveEngine::forSize(size)),
+      startNumber(initialNumber), symmetry(size, 1), symmetryFolding(true), evalCache(20),
+      parallelCutoff(3), probabilityCutoff(0.0), inPlaceSearch(false), tablebaseProbing(true), bookProbing(true),
+      persistentCacheProbing(true), timeBudgetMs(0),
+      stopSearch(false), hasDeadline(false), counters(1), directionMs(), lastStats()
 {
-    initDirectionVectors();
+    // Sized once here so collecting statistics never allocates during play
+    lastStats.maxNodes.assign(min(maxDepth + 1, int(MAX_STATS_DEPTH)), 0);
+    lastStats.chanceNodes.assign(lastStats.maxNodes.size(), 0);
+    searchRootForSize = withBoardSize(size, [](auto n)
+    {
+        return &ExpectimaxAI::searchRoot<decltype(n)::value>;
+    });
     initPossibleSpawnValues();
+    updateFoldedSymmetries();
+    evalTables = EvalTables::forSettings(gridSize, evalWeights);
+    updatePrecomputedMoves();
+}
+
+// Destructor
+ExpectimaxAI::~ExpectimaxAI()
+{
+    stopPondering();
+}
+
+// Only 3x3 play is solved; a book is only used if its moves are as good as this AI's search
+void ExpectimaxAI::updatePrecomputedMoves()
+{
+    if (tablebaseProbing && gridSize == 3)
+        tablebase = EndgameTablebase::forNumber(startNumber);
+    else
+        tablebase.reset();
+
+    openingBook.reset();
+    if (bookProbing)
+    {
+        shared_ptr<const OpeningBook> book = OpeningBook::forSettings(gridSize, startNumber);
+        if (book && book->covers(maxDepth, evalWeights, symmetry.getActiveCount()))
+            openingBook = book;
+    }
+
+    // Values searched with a probability cutoff depend on the path, so they are never shared
+    persistentCache.reset();
+    if (persistentCacheProbing && probabilityCutoff == 0.0)
+    {
+        shared_ptr<const PersistentCache> cache = PersistentCache::forSettings(gridSize, startNumber);
+        if (cache && cache->settings() == getCacheSettings())
+            persistentCache = cache;
+    }
+}
+
+// Fold the symmetries the evaluation cannot tell apart
+void ExpectimaxAI::updateFoldedSymmetries()
+{
+    if (!symmetryFolding)
+        symmetry.setActiveCount(1);
+    else if (evalWeights.decay == 1.0)
+        symmetry.setActiveCount(8);
+    else
+        symmetry.setActiveCount(2);
 }
 
 // Set decay factor
 void ExpectimaxAI::setDecayFactor(double factor)
 {
-    const_cast<double&>(decayFactor) = factor;
+    stopPondering();
+    EvalWeights weights = evalWeights;
+    weights.decay = factor;
+    setEvalWeights(weights);
+}
+
+// Set all evaluation weights
+void ExpectimaxAI::setEvalWeights(const EvalWeights& weights)
+{
+    stopPondering();
+    if (weights == evalWeights) return;
+    evalWeights = weights;
+    updateFoldedSymmetries();
+    evalTables = EvalTables::forSettings(gridSize, evalWeights);
+    updatePrecomputedMoves();
+    resetCache(); // Cached values were scored with the old weights
 }
 
 // Update spawn values
 void ExpectimaxAI::updateSpawnValues(int newStartNumber)
 {
+    stopPondering();
     startNumber = newStartNumber;
     initPossibleSpawnValues();
+    updatePrecomputedMoves();
+    resetCache(); // Cached values assumed the old spawn values
 }
 
-// Get best move
-char ExpectimaxAI::getBestMove()
+// Search every legal root direction to the given depth; returns false if the search was stopped
+template <int N>
+bool ExpectimaxAI::searchRoot(const PackedBoard& board, const SymmetricHash& hash, int depth,
+                              const int* order, bool* legal, double* scores, bool* finished)
 {
+    const char directions[4] = {'i', 'j', 'k', 'l'};
+    ThreadPool::TaskGroup group;
+    for (int k = 0; k < 4; k++)
+    {
+        int d = order[k];
+        PackedBoard newBoard = moveEngine.move<N>(board, directions[d]);
+        legal[d] = newBoard != board;
+        finished[d] = false;
+        if (!legal[d]) continue;
+        SymmetricHash newHash = hash;
+        symmetry.update(newHash, board, newBoard);
+        auto job = [this, newBoard, newHash, scores, finished, d, depth]
+        {
+            auto start = chrono::steady_clock::now();
+            double reach;
+            scores[d] = searchChild<N>(newBoard, newHash, depth - 1, false, 1.0, reach);
+            finished[d] = !stopSearch; // The flag never clears during a search
+            directionMs[d] += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        };
+
+        // Each direction's subtree is independent; the shared cache only holds exact values,
+        // so running them in parallel gives the same scores as running them in order, up to
+        // the rounding of folded mirror images that pickBestMove treats as ties
+        if (pool)
+            pool->spawn(group, job);
+        else
+            job();
+    }
+    if (pool)
+        pool->wait(group);
+    return !stopSearch;
+}
+
+// Pick the best direction in the fixed i/j/k/l order so ties always resolve the same way.
+// Scores within a relative TIE_TOLERANCE are ties: mirror images share one cache entry but
+// sum their spawns in another cell order, so the image searched first decides the last bits
+char ExpectimaxAI::pickBestMove(const bool* legal, const double* scores) const
+{
+    const char directions[4] = {'i', 'j', 'k', 'l'};
     char bestMove = 'n';
     double bestScore = -DBL_MAX;
+    for (int d = 0; d < 4; d++)
+    {
+        if (legal[d] && (bestMove == 'n' || scores[d] > bestScore + TIE_TOLERANCE * fabs(bestScore)))
+        {
+            bestScore = scores[d];
+            bestMove = directions[d];
+        }
+    }
+    return bestMove;
+}
+
+// Leaf evaluation with counting
+template <int N>
+double ExpectimaxAI::evaluateLeaf(const PackedBoard& b)
+{
+    threadCounters().leafEvaluations++;
+    return evalTables->evaluate<N>(b);
+}
 
-    for (char dir :
-            {'i', 'j', 'k', 'l'
-            })
+// Sum the per-thread counters
+void ExpectimaxAI::collectStats(int completedDepth, double totalMs)
+{
+    SearchStats& s = lastStats;
+    s.maxNodes.assign(min(maxDepth + 1, int(MAX_STATS_DEPTH)), 0);
+    s.chanceNodes.assign(s.maxNodes.size(), 0);
+    s.leafEvaluations = s.cacheProbes = s.cacheHits = s.persistentCacheHits = s.cacheStores = 0;
+    s.cacheEvictions = s.prunedNodes = 0;
+    for (const auto& c : counters)
     {
-        if (!tryMove(grid, dir)) continue;
-        auto newGrid = simulateMove(grid, dir);
-        double score = expectimax(newGrid, maxDepth - 1, false);
-        if (score > bestScore)
+        for (size_t d = 0; d < s.maxNodes.size(); d++)
         {
-            bestScore = score;
-            bestMove = dir;
+            s.maxNodes[d] += c.maxNodes[d];
+            s.chanceNodes[d] += c.chanceNodes[d];
         }
+        s.leafEvaluations += c.leafEvaluations;
+        s.cacheProbes += c.cacheProbes;
+        s.cacheHits += c.cacheHits;
+        s.persistentCacheHits += c.persistentCacheHits;
+        s.cacheStores += c.cacheStores;
+        s.cacheEvictions += c.cacheEvictions;
+        s.prunedNodes += c.prunedNodes;
+    }
+    s.usedCacheBytes = evalCache.usedBytes();
+    s.cacheCapacityBytes = evalCache.sizeInBytes();
+    for (int d = 0; d < 4; d++)
+        s.directionMs[d] = directionMs[d];
+    s.totalMs = totalMs;
+    s.completedDepth = completedDepth;
+    s.tablebaseHit = false;
+    s.openingBookHit = false;
+    s.ponderHit = false;
+}
+
+// Check the stop flag, and the clock every few thousand nodes when a deadline is set
+bool ExpectimaxAI::searchStopped()
+{
+    if (stopSearch.load(memory_order_relaxed)) return true;
+    if (!hasDeadline) return false;
+
+    static thread_local int nodesSinceCheck = 0;
+    if (++nodesSinceCheck < 4096) return false;
+    nodesSinceCheck = 0;
+    if (chrono::steady_clock::now() >= deadline)
+    {
+        stopSearch = true;
+        return true;
     }
+    return false;
+}
+
+// Get best move
+char ExpectimaxAI::getBestMove()
+{
+    int order[4] = {0, 1, 2, 3};
+    bool legal[4], finished[4];
+    double scores[4];
+    PackedBoard board = layout.pack(grid, EMPTY);
+    SymmetricHash hash;
+    symmetry.hash(board, hash);
+
+    // Values from earlier moves stay usable; only their replacement priority drops
+    stopPondering();
+    evalCache.newSearch();
+    stopSearch = false;
+    for (auto& c : counters)
+        c = SearchCounters();
+    for (double& ms : directionMs)
+        ms = 0.0;
+    auto searchStart = chrono::steady_clock::now();
+
+    // Solved positions need no search
+    char tablebaseMove;
+    double winProbability;
+    if (tablebase && tablebase->probe(board, tablebaseMove, winProbability))
+    {
+        collectStats(0, chrono::duration<double, milli>(chrono::steady_clock::now() - searchStart).count());
+        lastStats.tablebaseHit = true;
+        lastStats.winProbability = winProbability;
+        return tablebaseMove;
+    }
+    char bookMove;
+    if (openingBook && openingBook->probe(hash, symmetry, bookMove))
+    {
+        collectStats(0, chrono::duration<double, milli>(chrono::steady_clock::now() - searchStart).count());
+        lastStats.openingBookHit = true;
+        return bookMove;
+    }
+
+    // Boards pondered while the game waited; they were searched to maxDepth, which is at
+    // least as deep as a timed search gets
+    for (const auto& pondered : ponderedMoves)
+    {
+        if (pondered.first == board)
+        {
+            collectStats(0, chrono::duration<double, milli>(chrono::steady_clock::now() - searchStart).count());
+            lastStats.ponderHit = true;
+            return pondered.second;
+        }
+    }
+
+    if (timeBudgetMs <= 0)
+    {
+        hasDeadline = false;
+        (this->*searchRootForSize)(board, hash, maxDepth, order, legal, scores, finished);
+        collectStats(maxDepth, chrono::duration<double, milli>(chrono::steady_clock::now() - searchStart).count());
+        return pickBestMove(legal, scores);
+    }
+
+    // Anytime mode: deepen one ply at a time and keep the move of the deepest finished
+    // iteration. Depth 1 always runs to completion so there is a move to return.
+    // Every iteration searches the previous best direction first; once that one finished,
+    // an interrupted iteration still has the deeper scores to beat it with
+    deadline = chrono::steady_clock::now() + chrono::milliseconds(timeBudgetMs);
+    hasDeadline = false;
+    char bestMove = 'n';
+    int completedDepth = 0;
+    for (int depth = 1; depth <= maxDepth; depth++)
+    {
+        if (!(this->*searchRootForSize)(board, hash, depth, order, legal, scores, finished))
+        {
+            if (finished[order[0]])
+            {
+                bool searched[4];
+                for (int d = 0; d < 4; d++)
+                    searched[d] = legal[d] && finished[d];
+                bestMove = pickBestMove(searched, scores);
+            }
+            break;
+        }
+        completedDepth = depth;
+        bestMove = pickBestMove(legal, scores);
+        if (bestMove == 'n' || chrono::steady_clock::now() >= deadline)
+            break;
+        hasDeadline = true;
+
+        // Search the directions that looked best first next time; the reduction itself
+        // stays in i/j/k/l order
+        stable_sort(order, order + 4, [&](int a, int b)
+        {
+            double sa = legal[a] ? scores[a] : -DBL_MAX, sb = legal[b] ? scores[b] : -DBL_MAX;
+            return sa > sb;
+        });
+    }
+    hasDeadline = false;
+    collectStats(completedDepth, chrono::duration<double, milli>(chrono::steady_clock::now() - searchStart).count());
     return bestMove;
 }
 
 // Reset cache
 void ExpectimaxAI::resetCache()
 {
+    stopPondering();
     evalCache.clear();
+    ponderedMoves.clear();
+}
+
+// Resize cache
+void ExpectimaxAI::setCacheSize(int sizeBits)
+{
+    stopPondering();
+    evalCache.resize(sizeBits);
+}
+
+// Set the number of root search threads
+void ExpectimaxAI::setThreadCount(int threads)
+{
+    stopPondering();
+    if (threads > 1)
+        pool.reset(new ThreadPool(threads));
+    else
+        pool.reset();
+    counters.assign(max(threads, 1), SearchCounters());
+}
+
+// Set the parallel depth cutoff
+void ExpectimaxAI::setParallelCutoff(int depth)
+{
+    stopPondering();
+    parallelCutoff = depth;
+}
+
+// Set the probability cutoff
+void ExpectimaxAI::setProbabilityCutoff(double threshold)
+{
+    stopPondering();
+    probabilityCutoff = threshold;
+    updatePrecomputedMoves();
+    resetCache(); // Cached values were computed with the old cutoff
+}
+
+// Turn symmetry folding on or off
+void ExpectimaxAI::setSymmetryFolding(bool enabled)
+{
+    stopPondering();
+    symmetryFolding = enabled;
+    updateFoldedSymmetries();
+    updatePrecomputedMoves();
+    resetCache(); // Entries were keyed under the old folding
+}
+
+// Select the in-place search; lines deeper than the undo log always use the copying search
+void ExpectimaxAI::setInPlaceSearch(bool enabled)
+{
+    stopPondering();
+    inPlaceSearch = enabled && maxDepth <= MAX_UNDO;
+}
+
+// Turn tablebase probing on or off
+void ExpectimaxAI::setTablebaseProbing(bool enabled)
+{
+    stopPondering();
+    tablebaseProbing = enabled;
+    updatePrecomputedMoves();
+}
+
+// Turn opening book probing on or off
+void ExpectimaxAI::setOpeningBookProbing(bool enabled)
+{
+    stopPondering();
+    bookProbing = enabled;
+    updatePrecomputedMoves();
+}
+
+// Turn the on-disk cache on or off
+void ExpectimaxAI::setPersistentCacheProbing(bool enabled)
+{
+    stopPondering();
+    persistentCacheProbing = enabled;
+    updatePrecomputedMoves();
+}
+
+// Settings of cached values
+CacheSettings ExpectimaxAI::getCacheSettings() const
+{
+    return {gridSize, startNumber, symmetry.getActiveCount(), evalWeights};
+}
+
+// Copy the table's values that are worth keeping
+void ExpectimaxAI::exportSearchCache(CacheRun& run) const
+{
+    run.settings = getCacheSettings();
+    // Probes only take values of their own depth, so every value held was searched exactly
+    if (probabilityCutoff != 0.0) return;
+    evalCache.forEachValue([&](uint64_t key, int depth, TranspositionTable::NodeType type, double value)
+    {
+        if (depth >= PersistentCache::MIN_DEPTH)
+            run.records.push_back({key, value, uint32_t(depth), uint32_t(type)});
+    });
+}
+
+// Statistics of the last search
+const SearchStats& ExpectimaxAI::getSearchStats() const
+{
+    return lastStats;
+}
+
+// Set the per-move time budget
+void ExpectimaxAI::setTimeBudget(int milliseconds)
+{
+    stopPondering();
+    timeBudgetMs = milliseconds;
+}
+
+// Start the ponder thread on a snapshot of the grid
+void ExpectimaxAI::startPondering()
+{
+    stopPondering();
+    PackedBoard board = layout.pack(grid, EMPTY);
+
+    // Moves of boards the game has left behind are of no more use
+    ponderedMoves.erase(remove_if(ponderedMoves.begin(), ponderedMoves.end(),
+                                  [&](const pair<PackedBoard, char>& p) { return p.first != board; }),
+                        ponderedMoves.end());
+    stopSearch = false;
+    hasDeadline = false;
+    ponderThread = thread(&ExpectimaxAI::ponder, this, board);
+}
+
+// Stop the ponder thread; a search it leaves unfinished caches nothing
+void ExpectimaxAI::stopPondering()
+{
+    if (!ponderThread.joinable()) return;
+    stopSearch = true;
+    ponderThread.join();
+}
+
+// The game's next board is the current one after the AI's move and one random spawn, so
+// after the current board every spawn after its best move is searched, in cell order
+void ExpectimaxAI::ponder(PackedBoard board)
+{
+    vector<PackedBoard> boards = {board};
+    for (size_t next = 0; next < boards.size() && !stopSearch; next++)
+    {
+        PackedBoard b = boards[next];
+        SymmetricHash hash;
+        symmetry.hash(b, hash);
+
+        // Tablebase and book moves are instant anyway, and a board may be done already
+        char move = 'n';
+        double winProbability;
+        auto done = find_if(ponderedMoves.begin(), ponderedMoves.end(),
+                            [&](const pair<PackedBoard, char>& p) { return p.first == b; });
+        if (done != ponderedMoves.end())
+        {
+            move = done->second;
+        }
+        else if (!(tablebase && tablebase->probe(b, move, winProbability)) &&
+                 !(openingBook && openingBook->probe(hash, symmetry, move)))
+        {
+            int order[4] = {0, 1, 2, 3};
+            bool legal[4], finished[4];
+            double scores[4];
+            if (!(this->*searchRootForSize)(b, hash, maxDepth, order, legal, scores, finished))
+                return;
+            move = pickBestMove(legal, scores);
+            ponderedMoves.push_back(make_pair(b, move));
+        }
+        if (next > 0 || move == 'n') continue;
+
+        bool changed;
+        PackedBoard moved = simulateMove(b, move, changed);
+        for (uint32_t cells = getEmptyCells(moved); cells != 0; cells &= cells - 1)
+        {
+            int cell = __builtin_ctz(cells);
+            for (int code : possibleSpawnCodes)
+            {
+                PackedBoard spawned = moved;
+                layout.setCell(spawned, cell / gridSize, cell % gridSize, code);
+                if (!checkGameOver(spawned))
+                    boards.push_back(spawned);
+            }
+        }
+    }
 }
 
 // Play one step
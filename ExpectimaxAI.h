@@ -2,12 +2,28 @@
 #define EXPECTIMAXAI_H_INCLUDED
 
 #include "GridGame.h"
+#include "PackedBoard.h"
+#include "Board.h"
+#include "MoveEngine.h"
+#include "EvalTables.h"
+#include "BoardSymmetry.h"
+#include "EndgameTablebase.h"
+#include "OpeningBook.h"
+#include "PersistentCache.h"
+#include "TranspositionTable.h"
+#include "ThreadPool.h"
+#include "SearchStats.h"
 #include <vector>
 #include <string>
 #include <algorithm>
 #include <cfloat>
-#include <unordered_map>
 #include <cmath>
+#include <climits>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <utility>
 
 using namespace std;
 
@@ -15,78 +31,263 @@ class GridGame;
 
 class ExpectimaxAI
 {
+    friend class Benchmark;
+    friend class OpeningBook;
+
 private:
+    static const int MAX_STATS_DEPTH = 32; // Deeper nodes are counted with this depth
+
+    // Per-thread search counters, padded so threads never write to the same cache line
+    struct alignas(64) SearchCounters
+    {
+        long long maxNodes[MAX_STATS_DEPTH];
+        long long chanceNodes[MAX_STATS_DEPTH];
+        long long leafEvaluations, cacheProbes, cacheHits, persistentCacheHits, cacheStores, cacheEvictions;
+        long long prunedNodes;
+    };
+
+    static const int MAX_UNDO = 64; // Deepest line the in-place search can undo
+    static constexpr double TIE_TOLERANCE = 1e-12; // Relative score difference pickBestMove treats as a tie
+
+    // A board and its symmetric hashes; the copying search gives every child its own
+    struct SearchBoard
+    {
+        PackedBoard board;
+        SymmetricHash hash;
+    };
+
+    // The single board the in-place search works on, with its hashes and the boards its
+    // moves displaced; spawns are undone by clearing the cell, so they need no log entry.
+    // It keeps no running evaluation: a leaf follows a move, which rewrites every row of a
+    // vertical move, and spawns are already scored from their parent by evaluateSpawns
+    struct WorkingBoard
+    {
+        PackedBoard board;
+        SymmetricHash hash;
+        PackedBoard undoLog[MAX_UNDO];
+        int undoTop;
+    };
+
     vector<vector<int>>& grid;       // Reference to the game grid
     Position& position;              // Reference to the player position
     const int gridSize, maxDepth, EMPTY;  // Grid dimensions, search depth, and empty cell value
+    BoardLayout layout;              // Cell layout of packed search boards
+    const MoveEngine& moveEngine;    // Shared move lookup tables for this grid size
+    shared_ptr<const EvalTables> evalTables; // Shared row score tables for this grid size and weights
     int startNumber;                 // Starting number for tile generation
     vector<int> possibleSpawnValues; // Values that can spawn on the grid
-    unordered_map<string, double> evalCache; // Cache for grid evaluations
-    // Decay parameters
-    const double decayFactor = 0.5;  // Controls how quickly the weight decreases
+    vector<int> possibleSpawnCodes;  // Packed codes of the spawn values
+    BoardSymmetry symmetry;          // Incremental hashing, folded over the symmetries the evaluation ignores
+    bool symmetryFolding;            // Whether mirrored and rotated boards share cache entries
+    TranspositionTable evalCache;    // Fixed-size cache of node values, shared by all search threads
+    unique_ptr<ThreadPool> pool;     // Work-stealing search threads, null when searching on one thread
+    int parallelCutoff;              // Chance nodes with at least this depth left spawn their children as tasks
+    double probabilityCutoff;        // Nodes reached with a lower path probability get a static evaluation
+    bool inPlaceSearch;              // Search by make/unmake on one working board instead of copying
+    bool tablebaseProbing;           // Whether 3x3 moves are looked up before searching
+    shared_ptr<const EndgameTablebase> tablebase; // Solved 3x3 positions for the start number, null if none
+    bool bookProbing;                // Whether opening moves are looked up before searching
+    shared_ptr<const OpeningBook> openingBook; // Book for this size and start number if it covers the search
+    bool persistentCacheProbing;     // Whether values from earlier runs are looked up on disk
+    shared_ptr<const PersistentCache> persistentCache; // Earlier runs' values if searched with these settings
+    int timeBudgetMs;                // Per-move budget for iterative deepening, 0 for a fixed-depth search
+    atomic<bool> stopSearch;         // Set to abandon the running search
+    bool hasDeadline;                // Whether searchStopped should watch the clock
+    chrono::steady_clock::time_point deadline; // When the running iteration must stop
+    thread ponderThread;             // Background search while the game waits, joinable while it runs
+    vector<pair<PackedBoard, char>> ponderedMoves; // Boards pondered to maxDepth and their best moves;
+                                                   // only the ponder thread touches them while it runs
+    vector<SearchCounters> counters; // One set of counters per search thread
+    // searchRoot compiled for this AI's grid size, chosen once at construction
+    bool (ExpectimaxAI::*searchRootForSize)(const PackedBoard&, const SymmetricHash&, int,
+                                            const int*, bool*, double*, bool*);
+    double directionMs[4];           // Wall time per root direction during the running search
+    SearchStats lastStats;           // Statistics of the last getBestMove
+    // Evaluation parameters
+    EvalWeights evalWeights;         // Term weights; decay controls how quickly the position weight decreases
 
-    // Direction vector structure for movement processing
-    struct DirVector
-    {
-        int rowDelta, colDelta;      // Movement direction
-        int startRow, endRow, rowStep; // Row iteration parameters
-        int startCol, endCol, colStep; // Column iteration parameters
-    };
-    unordered_map<char, DirVector> dirVectors; // Maps direction keys to vectors
+    // Initializes possible spawn values based on startNumber
+    void initPossibleSpawnValues();
 
-    // Converts grid to string representation for caching
-    string gridToString(const vector<vector<int>>& g) const;
+    // Simulates a move in the given direction; changed is false if nothing moved
+    PackedBoard simulateMove(const PackedBoard& b, char dir, bool& changed) const;
 
-    // Checks if a position is within grid boundaries
-    bool isValidPosition(int row, int col) const;
+    // Returns a bitmask of empty cells, bit (row * gridSize + col)
+    uint32_t getEmptyCells(const PackedBoard& b) const;
 
-    // Initializes direction vectors for all possible moves
-    void initDirectionVectors();
+    // Checks if the board contains the winning value of 1
+    bool hasValueOne(const PackedBoard& b) const;
 
-    // Initializes possible spawn values based on startNumber
-    void initPossibleSpawnValues();
+    // Determines if the game is over (won or no moves possible)
+    bool checkGameOver(const PackedBoard& b) const;
 
-    // Calculates position weight based on distance from corner
-    double getPositionWeight(int row, int col) const;
+    // Evaluates board state and returns a score
+    double evaluateGrid(const PackedBoard& b) const;
 
-    // Checks if a move in the given direction is possible
-    bool tryMove(const vector<vector<int>>& g, char dir) const;
+    // Implements the expectimax algorithm for decision making; node is a SearchBoard for the
+    // copying search or a WorkingBoard for the in-place one, which differ only in how
+    // visitMove and visitSpawn reach a child. pathProb is the probability of the spawns that
+    // led to this node. reach is set to the smallest probability, relative to this node, with
+    // which the search reached a node that checked the probability cutoff (itself included);
+    // the value only holds along paths where pathProb * reach stays above the cutoff. N is the
+    // grid size, so every board kernel on the search path is compiled for one size
+    template <int N, typename Node>
+    double expectimax(Node& node, int depth, bool isMaxPlayer, double pathProb, double& reach);
 
-    // Simulates a move in the given direction and returns new grid
-    vector<vector<int>> simulateMove(const vector<vector<int>>& g, char dir) const;
+    // Calls visit with the board after a move; false, without calling it, if nothing moved.
+    // The copying search passes a new SearchBoard, the in-place search makes and unmakes the
+    // move on its working board
+    template <int N, typename Visit>
+    bool visitMove(const SearchBoard& node, char dir, Visit visit);
+    template <int N, typename Visit>
+    bool visitMove(WorkingBoard& node, char dir, Visit visit);
 
-    // Returns a list of all empty cell positions
-    vector<Position> getEmptyCells(const vector<vector<int>>& g) const;
+    // Calls visit with the board after a spawn of code on cell, in the same two ways
+    template <int N, typename Visit>
+    void visitSpawn(const SearchBoard& node, int cell, int code, Visit visit);
+    template <int N, typename Visit>
+    void visitSpawn(WorkingBoard& node, int cell, int code, Visit visit);
 
-    // Checks if the grid contains the winning value of 1
-    bool hasValueOne(const vector<vector<int>>& g) const;
+    // Applies a move to the working board, logging the board it replaces; false if nothing moved
+    template <int N>
+    bool makeMove(WorkingBoard& w, char dir);
 
-    // Determines if the game is over (won or no moves possible)
-    bool checkGameOver(const vector<vector<int>>& g) const;
+    // Restores the board and hashes from before the last makeMove
+    void unmakeMove(WorkingBoard& w);
+
+    // Searches a child from its own working board (root directions and parallel tasks)
+    template <int N>
+    double searchChild(const PackedBoard& b, const SymmetricHash& hash, int depth, bool isMaxPlayer,
+                       double pathProb, double& reach);
+
+    // Maps the 3x3 tablebase, the opening book and the on-disk cache that apply to the
+    // current settings, if probing them is on and they were built
+    void updatePrecomputedMoves();
+
+    // Looks a node reached with pathProb up in the transposition table, then on disk; a disk
+    // hit is copied into the table. Sets reach as expectimax does. Counts the probe and the hit
+    bool probeCaches(uint64_t key, int depth, TranspositionTable::NodeType type, double pathProb,
+                     double& value, double& reach, SearchCounters& stats);
+
+    // Stores a node's value unless a probability cut below it made it depend on the path
+    void storeValue(uint64_t key, int depth, TranspositionTable::NodeType type, double value,
+                    double pathProb, double reach, SearchCounters& stats);
+
+    // Picks the symmetries to fold: the transpose keeps every position weight, and with a
+    // decay of 1 all weights are equal so all eight symmetries score alike
+    void updateFoldedSymmetries();
 
-    // Evaluates grid state and returns a score
-    double evaluateGrid(const vector<vector<int>>& g) const;
+    // Returns the counters of the calling search thread
+    SearchCounters& threadCounters() { return counters[pool ? pool->queueIndex() : 0]; }
 
-    // Implements the expectimax algorithm for decision making
-    double expectimax(const vector<vector<int>>& g, int depth, bool isMaxPlayer);
+    // Scores a leaf, terminal or cut node and counts it
+    template <int N>
+    double evaluateLeaf(const PackedBoard& b);
+
+    // Sums the per-thread counters into lastStats
+    void collectStats(int completedDepth, double totalMs);
+
+    // Returns true once the running search has to stop
+    bool searchStopped();
+
+    // Searches the legal root directions (in the given index order) to a depth; finished
+    // marks the directions whose score is complete. Returns false if the search was stopped
+    // before every direction finished
+    template <int N>
+    bool searchRoot(const PackedBoard& board, const SymmetricHash& hash, int depth,
+                    const int* order, bool* legal, double* scores, bool* finished);
+
+    // Chooses the best legal direction from root scores, 'n' if there is none
+    char pickBestMove(const bool* legal, const double* scores) const;
+
+    // Body of the ponder thread: searches the board, then every board its best move can lead to,
+    // until the search is stopped
+    void ponder(PackedBoard board);
+
+    // Expands a chance node's children as parallel tasks and sums them in a fixed order
+    template <int N>
+    double parallelChance(const PackedBoard& b, const SymmetricHash& hash, int depth,
+                          uint32_t emptyCells, double childProb, double pathProb, double& reach);
 
 public:
     // Constructor initializes the AI with game parameters
     ExpectimaxAI(vector<vector<int>>& g, Position& pos, int size,
                  int initialNumber, int depth, int empty);
 
+    // Destructor stops pondering
+    ~ExpectimaxAI();
+
     // Customizes the decay factor for position weighting
     void setDecayFactor(double factor);
 
+    // Replaces every evaluation weight, decay included (clears the cache if they change)
+    void setEvalWeights(const EvalWeights& weights);
+
+    // Returns the evaluation weights
+    const EvalWeights& getEvalWeights() const { return evalWeights; }
+
     // Updates spawn values when the game configuration changes
     void updateSpawnValues(int newStartNumber);
 
     // Determines and returns the best move direction
     char getBestMove();
 
-    // Clears the evaluation cache
+    // Clears the evaluation cache (not needed between moves, values are kept and aged)
     void resetCache();
 
+    // Resizes the evaluation cache to 2^sizeBits entries (clears it)
+    void setCacheSize(int sizeBits);
+
+    // Searches on this many threads (1 = sequential)
+    void setThreadCount(int threads);
+
+    // Sets the remaining depth at or above which chance-node children become parallel tasks
+    void setParallelCutoff(int depth);
+
+    // Stops expanding lines whose spawn probability falls below threshold (0 = never)
+    void setProbabilityCutoff(double threshold);
+
+    // Lets boards that are reflections or rotations of each other share cache entries (default on)
+    void setSymmetryFolding(bool enabled);
+
+    // Searches by making and unmaking moves on one working board instead of copying boards
+    // (default off); both searches give the same values. Only the hashes are updated
+    // incrementally: leaves are scored in full as in the copying search
+    void setInPlaceSearch(bool enabled);
+
+    // Plays 3x3 positions from the solved tablebase when its file exists (default on)
+    void setTablebaseProbing(bool enabled);
+
+    // Plays opening positions from the book for this size and start number when its file exists
+    // and it was searched at least as deep as maxDepth with the same evaluation (default on)
+    void setOpeningBookProbing(bool enabled);
+
+    // Looks values up in the search cache file of earlier runs when it exists and was made
+    // with the same settings (default on)
+    void setPersistentCacheProbing(bool enabled);
+
+    // Returns the settings this AI's cached values depend on
+    CacheSettings getCacheSettings() const;
+
+    // Adds the values in the transposition table to a run, for merging into the cache file;
+    // adds nothing while a probability cutoff is set, since those values depend on the path
+    void exportSearchCache(CacheRun& run) const;
+
+    // Returns what the last getBestMove did: nodes per depth, cache use, cuts and timings
+    const SearchStats& getSearchStats() const;
+
+    // Deepens the search one ply at a time until the budget runs out or maxDepth is reached
+    // (0 = always search maxDepth)
+    void setTimeBudget(int milliseconds);
+
+    // Starts searching the grid on a background thread while the game waits for input; values
+    // go into the cache and finished moves are returned at once by getBestMove. The grid must
+    // not change until stopPondering; getBestMove and every setter stop pondering first
+    void startPondering();
+
+    // Cancels pondering and waits for the thread; the moves it finished are kept
+    void stopPondering();
+
     // Executes one AI move in the game
     bool playOneStep(GridGame* game);
 };
@@ -0,0 +1,43 @@
+#include "FrameQueue.h"
+#include <utility>
+
+// Constructor
+FrameQueue::FrameQueue(size_t capacity, bool latestOnly)
+    : capacity(capacity > 0 ? capacity : 1), latestOnly(latestOnly), closed(false) {
+}
+
+// Add a frame for the renderer
+void FrameQueue::push(Frame frame) {
+    unique_lock<mutex> guard(lock);
+    if (latestOnly) {
+        while (frames.size() >= capacity) frames.pop_front();
+    } else {
+        changed.wait(guard, [this] { return frames.size() < capacity; });
+    }
+    frames.push_back(move(frame));
+    changed.notify_all();
+}
+
+// Whether the next push would wait; only the player pushes, so a free slot stays free until then
+bool FrameQueue::full() {
+    lock_guard<mutex> guard(lock);
+    return !latestOnly && frames.size() >= capacity;
+}
+
+// Take the next frame to show
+bool FrameQueue::pop(Frame& frame) {
+    unique_lock<mutex> guard(lock);
+    changed.wait(guard, [this] { return !frames.empty() || closed; });
+    if (frames.empty()) return false;
+    frame = move(frames.front());
+    frames.pop_front();
+    changed.notify_all();
+    return true;
+}
+
+// No more frames
+void FrameQueue::close() {
+    lock_guard<mutex> guard(lock);
+    closed = true;
+    changed.notify_all();
+}
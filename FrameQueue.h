@@ -0,0 +1,52 @@
+#ifndef FRAMEQUEUE_H_INCLUDED
+#define FRAMEQUEUE_H_INCLUDED
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+
+using namespace std;
+
+// One state of the AI's grid during auto-play, as the renderer shows it
+struct Frame {
+    vector<vector<int>> grid; // Copy of the grid after the move and its spawn
+    int move;                 // Moves played so far
+    string stats;             // Search statistics of the move, empty if they are switched off
+};
+
+/**
+ * @class FrameQueue
+ * @brief Hands frames from the playing thread to the rendering thread.
+ *        A queue that keeps every frame holds up to capacity of them and makes push wait
+ *        while it is full, so play runs at most that far ahead of the screen. A queue that
+ *        keeps only the latest frame never waits: a new frame replaces one not yet shown.
+ */
+class FrameQueue {
+private:
+    mutex lock;
+    condition_variable changed;
+    deque<Frame> frames;
+    size_t capacity;  // Frames held at most
+    bool latestOnly;  // Replace unshown frames instead of waiting for room
+    bool closed;      // No more frames will be pushed
+
+public:
+    // Constructor; latestOnly drops frames the renderer has not caught up with
+    FrameQueue(size_t capacity, bool latestOnly);
+
+    // Adds a frame, waiting for room unless the queue keeps only the latest frame
+    void push(Frame frame);
+
+    // Returns true if push would wait now; a queue of the latest frame never is full
+    bool full();
+
+    // Takes the oldest frame, waiting for one; false once the queue is closed and empty
+    bool pop(Frame& frame);
+
+    // Marks the end of the frames; pop returns what is left, then false
+    void close();
+};
+
+#endif // FRAMEQUEUE_H_INCLUDED
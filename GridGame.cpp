@@ -1,5 +1,9 @@
 #include "GridGame.h"
 #include "ExpectimaxAI.h"
+#include "SmartMergeMax.h"
+#include "MoveEngine.h"
+#include "FrameQueue.h"
+#include <sstream>
 
 // Initialize possible spawn values based on the starting number
 void GridGame::initPossibleSpawnValues() {
@@ -111,79 +115,19 @@ void GridGame::spawnRandomNumber(vector<vector<int>>& grid) {
 
 // Moves tiles in a given direction and handles merging
 bool GridGame::processMovement(Position& pos, vector<vector<int>>& grid, char dir) {
-    bool gridChanged = false;
     dir = tolower(dir);
-
-    struct MoveVector {
-        int rowDelta;
-        int colDelta;
-        int startRow;
-        int endRow;
-        int rowStep;
-        int startCol;
-        int endCol;
-        int colStep;
-    };
-
-    MoveVector moveVectors;
-
-    switch(dir) {
-    case 's':
-    case 'k': // Down
-        moveVectors = {1, 0, gridSize-2, -1, -1, 0, gridSize, 1};
-        break;
-    case 'w':
-    case 'i': // Up
-        moveVectors = {-1, 0, 1, gridSize, 1, 0, gridSize, 1};
-        break;
-    case 'a':
-    case 'j': // Left
-        moveVectors = {0, -1, 0, gridSize, 1, 1, gridSize, 1};
-        break;
-    case 'd':
-    case 'l': // Right
-        moveVectors = {0, 1, 0, gridSize, 1, gridSize-2, -1, -1};
-        break;
-    default:
+    char engineDir = MoveEngine::toEngineDirection(dir);
+    if (engineDir == 0) {
         return false;
     }
 
-    for (int row = moveVectors.startRow; row != moveVectors.endRow; row += moveVectors.rowStep) {
-        for (int col = moveVectors.startCol; col != moveVectors.endCol; col += moveVectors.colStep) {
-            if (grid[row][col] != EMPTY) {
-                int newRow = row;
-                int newCol = col;
-
-                while (true) {
-                    int nextRow = newRow + moveVectors.rowDelta;
-                    int nextCol = newCol + moveVectors.colDelta;
-
-                    if (nextRow >= 0 && nextRow < gridSize &&
-                            nextCol >= 0 && nextCol < gridSize &&
-                            (grid[nextRow][nextCol] == EMPTY ||
-                             grid[nextRow][nextCol] == grid[row][col])) {
-                        newRow = nextRow;
-                        newCol = nextCol;
-                    } else {
-                        break;
-                    }
-                }
-
-                if (newRow != row || newCol != col) {
-                    if (grid[newRow][newCol] == grid[row][col]) {
-                        grid[newRow][newCol] /= 2;
-                        grid[row][col] = EMPTY;
-                    } else {
-                        grid[newRow][newCol] = grid[row][col];
-                        grid[row][col] = EMPTY;
-                    }
-                    gridChanged = true;
-                }
-            }
-        }
-    }
+    // Slide and merge with the same move tables the AIs search with
+    BoardLayout layout(gridSize);
+    PackedBoard board = layout.pack(grid, EMPTY);
+    PackedBoard moved = MoveEngine::forSize(gridSize).move(board, engineDir);
 
-    if (gridChanged) {
+    if (moved != board) {
+        layout.unpack(moved, grid, EMPTY);
         Position newPos = calculateNewPosition(pos, dir);
         if (isValidPosition(newPos)) {
             pos = newPos;
@@ -250,11 +194,59 @@ GridGame::GridGame(const string& InputFile) : rng(random_device()()) {
     validateConfiguration();
     initializeGrids();
     Ai2Count=0;
+    showSearchStats=false;
+    pondering=true;
+    frameDelayMs=300;
     pos1={0,0};
     pos2={0,0};
+    ai=nullptr; // Built by run, once the search settings are final
+}
 
-    // the biggest line of code. My magnum opus
-    ai = new ExpectimaxAI(grid2, pos2, gridSize, currentNumber, 7, EMPTY);
+// Constructor for headless games
+GridGame::GridGame(int size, int number, unsigned seed, const SearchSettings& settings) : rng(seed) {
+    currentNumber = number;
+    gridSize = size;
+    validateConfiguration();
+    initializeGrids();
+    Ai2Count=0;
+    showSearchStats=false;
+    pondering=false;
+    frameDelayMs=0;
+    pos1={0,0};
+    pos2={0,0};
+    ai=nullptr;
+    setSearchSettings(settings);
+}
+
+// Builds the Expectimax AI the first time a game needs it
+ExpectimaxAI& GridGame::expectimaxAi() {
+    if (!ai) {
+        ai = new ExpectimaxAI(grid2, pos2, gridSize, currentNumber, search.depth, EMPTY);
+        ai->setEvalWeights(search.weights);
+        ai->setThreadCount(search.threads);
+        if (search.probabilityCutoff > 0.0) ai->setProbabilityCutoff(search.probabilityCutoff);
+        ai->setTimeBudget(search.timeBudgetMs);
+    }
+    return *ai;
+}
+
+// The depth is fixed when an AI is built, so a built AI is replaced
+void GridGame::setSearchSettings(const SearchSettings& settings) {
+    if (settings.depth < 1 || settings.threads < 1) {
+        throw invalid_argument("Search depth and threads must be positive");
+    }
+    if (!(settings.probabilityCutoff >= 0.0 && settings.probabilityCutoff < 1.0)) {
+        throw invalid_argument("Probability cutoff must be at least 0 and below 1");
+    }
+    if (settings.timeBudgetMs < 0) {
+        throw invalid_argument("Time budget must not be negative");
+    }
+    search = settings;
+    if (ai) {
+        delete ai;
+        ai = nullptr;
+        expectimaxAi();
+    }
 }
 
 // Destructor to clean up the AI
@@ -316,6 +308,11 @@ void GridGame::handleInput(char input) {
 
 // Prints out both grids side-by-side with current number
 void GridGame::displayGameState() const {
+    printBoards(grid2);
+}
+
+// Prints grid 1 beside a state of grid 2
+void GridGame::printBoards(const vector<vector<int>>& aiGrid) const {
     // Header
     cout << "---------------------------------------------------------------------\n";
     cout << "Game 1: reverse 512 (" << gridSize << " x " << gridSize << ") - Initial Board\n";
@@ -338,10 +335,10 @@ void GridGame::displayGameState() const {
         // Grid 2 (AI)
         cout << "|";
         for (int col = 0; col < gridSize; ++col) {
-            if (grid2[row][col] == EMPTY)
+            if (aiGrid[row][col] == EMPTY)
                 cout << setw(5) << " - ";
             else
-                cout << setw(5) << grid2[row][col];
+                cout << setw(5) << aiGrid[row][col];
         }
         cout << " |"; // Close Grid 2
 
@@ -360,63 +357,147 @@ void GridGame::showControls() const {
          << "IJKL - Move Grid 2 (AI is controlling this grid)\n"
          << "Q - Quit\n"
          << "A - Let AI play one step\n"
-         << "P - Let AI play until game over\n\n";
+         << "P - Let AI play until game over\n"
+         << "T - Toggle AI search statistics\n"
+         << "O - Toggle AI pondering (searching while you think)\n\n";
 }
 
 // Let the AI play one step
 bool GridGame::aiPlayOneStep() {
-    ai->resetCache(); // cashing system, resets after a move to get new calculations
-    return ai->playOneStep(this);
+    // cached results are kept between moves, the AI ages them itself
+    bool moved = ai->playOneStep(this);
+    logSearchStats();
+    return moved;
 }
 
-// Let the AI play until game over
+// Prints the AI's statistics for its last move if they are switched on
+void GridGame::logSearchStats() const {
+    if (showSearchStats) {
+        ai->getSearchStats().print(cout);
+    }
+}
+
+// Let the AI play until game over. Showing the boards and pacing them run on a renderer
+// thread, so the next search starts as soon as the spawn is known
 void GridGame::aiPlayUntilGameOver() {
     cout << "AI playing automatically. Press Ctrl+C to stop.\n";
 
-    bool gameEnded = false;
+    // Paced play shows every board and stays at most a few moves ahead of the screen;
+    // unthrottled play shows the newest board whenever the renderer is free
+    FrameQueue frames(frameDelayMs > 0 ? FRAMES_AHEAD : 1, frameDelayMs == 0);
+    thread renderer([&] {
+        Frame frame;
+        while (frames.pop(frame)) {
+            printBoards(frame.grid);
+            cout << "AI move " << frame.move << "\n" << frame.stats;
+            if (frameDelayMs > 0) {
+                this_thread::sleep_for(chrono::milliseconds(frameDelayMs));
+            }
+        }
+    });
+
     Ai2Count=0;
-    while (!gameEnded) {
-        ai->resetCache();
-        bool validMove = ai->playOneStep(this);
+    bool validMove = true;
+    while (validMove && !checkGameOver(grid2)) {
+        validMove = ai->playOneStep(this);
         if(validMove){
             Ai2Count++;
+            ostringstream stats;
+            if (showSearchStats) ai->getSearchStats().print(stats);
+
+            // A full queue waits for the renderer; the AI already searches its next move meanwhile
+            bool waits = pondering && frames.full();
+            if (waits) ai->startPondering();
+            frames.push({grid2, Ai2Count, stats.str()});
+            if (waits) ai->stopPondering();
         }
+    }
+    frames.close();
+    renderer.join();
 
-        if (!validMove) {
-            cout << "AI has no valid moves left.\n";
-            gameEnded = true;
-        }
+    if (!validMove) {
+        cout << "AI has no valid moves left.\n";
+    }
 
-        if (checkGameOver(grid2)) {
-            displayGameState();
-            cout << "\nGame Over for Grid 2 (AI)! ";
-            for (int i = 0; i < gridSize; i++) {
-                for (int j = 0; j < gridSize; j++) {
-                    if (grid2[i][j] == 2) {
-                        cout << "I love beating idiots like you \n";
-                        cout << " Expectimax Ai beat you with "<<Ai2Count<<" moves.";
-                        return;
-                    }
+    if (checkGameOver(grid2)) {
+        // The renderer already showed the board of the last move
+        if (Ai2Count == 0) displayGameState();
+        cout << "\nGame Over for Grid 2 (AI)! ";
+        for (int i = 0; i < gridSize; i++) {
+            for (int j = 0; j < gridSize; j++) {
+                if (grid2[i][j] == 2) {
+                    cout << "I love beating idiots like you \n";
+                    cout << " Expectimax Ai beat you with "<<Ai2Count<<" moves.";
+                    return;
                 }
             }
-            cout << "No more moves possible.\n";
-            return;
+        }
+        cout << "No more moves possible.\n";
+    }
+}
+
+// Lets an AI play grid 2 to the end without any output or delay
+GameResult GridGame::playHeadless(AiType type) {
+    SmartMergeMax smartMerge;
+    GameResult result = {false, 0, 0.0, 0};
+    if (type == AiType::Expectimax) {
+        expectimaxAi(); // Built before the clock starts, so searchMs only counts searching
+    }
+
+    while (!checkGameOver(grid2)) {
+        auto start = chrono::steady_clock::now();
+        char move = type == AiType::Expectimax ? ai->getBestMove()
+                                               : smartMerge.getBestMove(grid2, pos2);
+        result.searchMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (type == AiType::Expectimax) {
+            result.searchNodes += ai->getSearchStats().totalNodes();
         }
 
-        // delay stuff
-        this_thread::sleep_for(chrono::milliseconds(300));
+        if (move == 'n' || !processMovement(pos2, grid2, move)) {
+            break;
+        }
+        result.moves++;
     }
+
+    for (int i = 0; i < gridSize; i++) {
+        for (int j = 0; j < gridSize; j++) {
+            if (grid2[i][j] == 2) {
+                result.won = true;
+            }
+        }
+    }
+    return result;
+}
+
+// Sets the auto-play pacing
+void GridGame::setFrameDelay(int milliseconds) {
+    if (milliseconds < 0) {
+        throw invalid_argument("Frame delay must not be negative");
+    }
+    frameDelayMs = milliseconds;
+}
+
+// Hands the AI's cached values to a run
+void GridGame::exportSearchCache(CacheRun& run) const {
+    // A game another AI played has no cached values
+    if (ai) ai->exportSearchCache(run);
 }
 
 // Starts the main game loop
 void GridGame::run() {
+    // the biggest line of code. My magnum opus
+    expectimaxAi();
+
     showControls();
     displayGameState();
 
     char input;
     do {
+        // The AI searches grid 2 until a key arrives; any input may change the grid
+        if (pondering) ai->startPondering();
         cout << "> ";
         cin >> input;
+        ai->stopPondering();
 
         input = tolower(input);
 
@@ -425,6 +506,12 @@ void GridGame::run() {
             aiPlayOneStep();
         } else if (input =='p') {
             aiPlayUntilGameOver();
+        } else if (input == 't') {
+            showSearchStats = !showSearchStats;
+            cout << "Search statistics " << (showSearchStats ? "on" : "off") << "\n";
+        } else if (input == 'o') {
+            pondering = !pondering;
+            cout << "Pondering " << (pondering ? "on" : "off") << "\n";
         } else {
             handleInput(input);
         }
@@ -12,6 +12,8 @@
 #include <algorithm>
 #include <chrono>
 #include <thread>
+#include "PersistentCache.h"
+#include "EvalWeights.h"
 
 using namespace std;
 
@@ -29,7 +31,32 @@ struct Position {
 // Forward declaration of ExpectimaxAI
 class ExpectimaxAI;
 
+// Which AI drives grid 2 in a headless game
+enum class AiType {
+    Expectimax,
+    SmartMergeMax
+};
+
+// How the Expectimax AI of grid 2 searches
+struct SearchSettings {
+    int depth = 7;       // Plies searched ahead
+    EvalWeights weights; // Evaluation weights
+    int threads = 1;     // Search threads, 1 for a sequential search
+    double probabilityCutoff = 0.0; // Lines reached less likely than this are scored statically, 0 for none
+    int timeBudgetMs = 0; // Per-move budget, deepening up to depth; 0 always searches depth plies
+};
+
+// Outcome of one headless game
+struct GameResult {
+    bool won;        // A 2 was reached
+    int moves;       // Moves played
+    double searchMs; // Time spent choosing moves
+    long long searchNodes; // Nodes the Expectimax AI searched, 0 for other AIs
+};
+
 class GridGame {
+    friend class Benchmark;
+
 private:
     // Constants for grid setup
     const vector<int> VALID_NUMBERS = {128, 256, 512};
@@ -42,6 +69,10 @@ private:
     int currentNumber;
     int Ai1Count;
     int Ai2Count;
+    bool showSearchStats; // Print the AI's search statistics after each of its moves
+    bool pondering;       // Let the AI search grid 2 in the background while waiting for input
+    int frameDelayMs;     // Pause after each board shown during auto-play, 0 for unthrottled
+    static const int FRAMES_AHEAD = 8; // Boards paced auto-play may search ahead of the screen
 
     vector<vector<int>> grid1, grid2; // Two separate game boards
 
@@ -51,8 +82,12 @@ private:
     // Tracks positions on each grid
     Position pos1, pos2;
 
-    // AI for grid2
+    // AI for grid2; headless games build it on first use, so other AIs never pay for its table
     ExpectimaxAI* ai;
+    SearchSettings search; // How the Expectimax AI searches
+
+    // Returns the Expectimax AI of grid 2, building it if the game has none yet
+    ExpectimaxAI& expectimaxAi();
 
     // Initialize possible spawn values based on the starting number
     void initPossibleSpawnValues();
@@ -78,13 +113,23 @@ private:
     // Checks if the game has reached a win or stalemate for a grid
     bool checkGameOver(const vector<vector<int>>& grid) const;
 
+    // Prints grid 1 beside a state of grid 2
+    void printBoards(const vector<vector<int>>& aiGrid) const;
+
 public:
     // Constructor that loads config and starts game
     GridGame(const string& InputFile = "reverse2048.txt");
 
+    // Constructor for headless games: no config file, seeded random numbers, and the
+    // settings of the Expectimax AI
+    GridGame(int size, int number, unsigned seed, const SearchSettings& settings = SearchSettings());
+
     // Destructor to clean up the AI
     ~GridGame();
 
+    // Changes how the Expectimax AI searches; an AI already built is rebuilt with the settings
+    void setSearchSettings(const SearchSettings& settings);
+
     // Process user input
     void handleInput(char input);
 
@@ -97,12 +142,25 @@ public:
     // Let the AI play one step
     bool aiPlayOneStep();
 
+    // Prints the AI's statistics for its last move if they are switched on
+    void logSearchStats() const;
+
     // Let the AI play until game over
     void aiPlayUntilGameOver();
 
+    // Sets the pause after each board auto-play shows; 0 shows the newest board whenever the
+    // screen is free and never holds the AI up. Throws invalid_argument if negative
+    void setFrameDelay(int milliseconds);
+
     // Starts the main game loop
     void run();
 
+    // Lets an AI play grid 2 to the end without any output or delay
+    GameResult playHeadless(AiType type);
+
+    // Adds the values the Expectimax AI has cached to a run for the on-disk search cache
+    void exportSearchCache(CacheRun& run) const;
+
 
 
 
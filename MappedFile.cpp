@@ -0,0 +1,96 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Constructor
+#ifdef _WIN32
+MappedFile::MappedFile()
+    : bytes(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr)
+{
+}
+#else
+MappedFile::MappedFile()
+    : bytes(nullptr), length(0), descriptor(-1)
+{
+}
+#endif
+
+// Destructor
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+// Map the whole file read-only
+bool MappedFile::open(const string& path)
+{
+    close();
+#ifdef _WIN32
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr)
+    {
+        close();
+        return false;
+    }
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr)
+    {
+        close();
+        return false;
+    }
+    bytes = static_cast<const unsigned char*>(view);
+    length = size_t(fileSize.QuadPart);
+#else
+    descriptor = ::open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) return false;
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size == 0)
+    {
+        close();
+        return false;
+    }
+    void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, descriptor, 0);
+    if (view == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    bytes = static_cast<const unsigned char*>(view);
+    length = size_t(info.st_size);
+#endif
+    return true;
+}
+
+// Unmap and close
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (bytes != nullptr) UnmapViewOfFile(bytes);
+    if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (bytes != nullptr) munmap(const_cast<unsigned char*>(bytes), length);
+    if (descriptor >= 0) ::close(descriptor);
+    descriptor = -1;
+#endif
+    bytes = nullptr;
+    length = 0;
+}
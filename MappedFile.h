@@ -0,0 +1,50 @@
+#ifndef MAPPEDFILE_H_INCLUDED
+#define MAPPEDFILE_H_INCLUDED
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory map of a whole file.
+ *        The operating system pages the file in as it is read and shares the pages
+ *        between processes, so large lookup tables cost nothing until they are probed.
+ */
+class MappedFile
+{
+private:
+    const unsigned char* bytes; // First byte of the mapping, null when nothing is mapped
+    size_t length;              // Bytes mapped
+#ifdef _WIN32
+    void* fileHandle;           // Handle of the open file
+    void* mappingHandle;        // Handle of the file mapping
+#else
+    int descriptor;             // Descriptor of the open file, -1 when closed
+#endif
+
+public:
+    // Constructor leaves nothing mapped
+    MappedFile();
+
+    // Destructor unmaps the file
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps a file read-only; false if it does not exist, is empty or cannot be mapped
+    bool open(const string& path);
+
+    // Unmaps the file
+    void close();
+
+    // Returns the mapped bytes, null when nothing is mapped
+    const unsigned char* data() const { return bytes; }
+
+    // Returns the number of bytes mapped
+    size_t size() const { return length; }
+};
+
+#endif // MAPPEDFILE_H_INCLUDED
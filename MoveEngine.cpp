@@ -0,0 +1,163 @@
+#include "MoveEngine.h"
+#include <stdexcept>
+#include <cctype>
+
+// Constructor
+MoveEngine::MoveEngine(int size) : layout(size)
+{
+    buildTables();
+}
+
+// Shared engine per grid size
+const MoveEngine& MoveEngine::forSize(int size)
+{
+    switch (size)
+    {
+    case 3:
+    {
+        static const MoveEngine engine3(3);
+        return engine3;
+    }
+    case 4:
+    {
+        static const MoveEngine engine4(4);
+        return engine4;
+    }
+    case 5:
+    {
+        static const MoveEngine engine5(5);
+        return engine5;
+    }
+    }
+    throw invalid_argument("Grid size must be between 3 and 5");
+}
+
+// Slide one line towards index 0 the way GridGame always has, merging equal tiles by division
+uint32_t MoveEngine::slideLine(int* cells, int length)
+{
+    uint32_t record = 0;
+    int merges = 0;
+    for (int k = 1; k < length; k++)
+    {
+        int code = cells[k];
+        if (code == 0) continue;
+
+        int p = k;
+        while (p > 0 && (cells[p - 1] == 0 || cells[p - 1] == code))
+            p--;
+
+        if (p != k)
+        {
+            if (cells[p] == code)
+            {
+                cells[p] = code - 1;
+                record |= uint32_t(code - 1) << (4 + merges * 4);
+                merges++;
+            }
+            else
+            {
+                cells[p] = code;
+            }
+            cells[k] = 0;
+        }
+    }
+    return record | merges;
+}
+
+// Tabulate every line of gridSize nibbles in both directions
+void MoveEngine::buildTables()
+{
+    int n = layout.size();
+    uint32_t lineCount = 1u << (n * 4);
+    leftTable.resize(lineCount);
+    rightTable.resize(lineCount);
+    leftMerges.resize(lineCount);
+    rightMerges.resize(lineCount);
+
+    int cells[5];
+    for (uint32_t line = 0; line < lineCount; line++)
+    {
+        // Towards nibble 0
+        for (int c = 0; c < n; c++)
+            cells[c] = (line >> (c * 4)) & 0xF;
+        leftMerges[line] = slideLine(cells, n);
+        uint32_t result = 0;
+        for (int c = 0; c < n; c++)
+            result |= uint32_t(cells[c]) << (c * 4);
+        leftTable[line] = result;
+
+        // Towards the last nibble is the same slide on the mirrored line
+        for (int c = 0; c < n; c++)
+            cells[c] = (line >> ((n - 1 - c) * 4)) & 0xF;
+        rightMerges[line] = slideLine(cells, n);
+        result = 0;
+        for (int c = 0; c < n; c++)
+            result |= uint32_t(cells[c]) << ((n - 1 - c) * 4);
+        rightTable[line] = result;
+    }
+}
+
+// Move in a direction
+PackedBoard MoveEngine::move(const PackedBoard& b, char dir) const
+{
+    return withBoardSize(layout.size(), [&](auto size)
+    {
+        return move<decltype(size)::value>(b, dir);
+    });
+}
+
+// Move a board line by line, collecting the merge record of every line
+MoveResult MoveEngine::moveWithMerges(const PackedBoard& b, char dir) const
+{
+    MoveResult result = {b, false, 0, {}};
+    const int n = layout.size();
+    bool rows = dir == 'j' || dir == 'l';
+    bool towardsStart = dir == 'j' || dir == 'i';
+    if (!rows && dir != 'i' && dir != 'k')
+        return result;
+    const vector<uint32_t>& lines = towardsStart ? leftTable : rightTable;
+    const vector<uint32_t>& merges = towardsStart ? leftMerges : rightMerges;
+
+    for (int k = 0; k < n; k++)
+    {
+        // Gather row or column k as a line, first cell in the lowest nibble
+        uint32_t line = 0;
+        for (int c = 0; c < n; c++)
+            line |= uint32_t(rows ? layout.getCell(b, k, c) : layout.getCell(b, c, k)) << (c * 4);
+
+        uint32_t moved = lines[line];
+        if (moved == line) continue;
+        result.changed = true;
+        addMerges(result, merges[line]);
+        for (int c = 0; c < n; c++)
+        {
+            int code = (moved >> (c * 4)) & 0xF;
+            if (rows)
+                layout.setCell(result.board, k, c, code);
+            else
+                layout.setCell(result.board, c, k, code);
+        }
+    }
+    return result;
+}
+
+// Direction keys
+char MoveEngine::toEngineDirection(char dir)
+{
+    switch (tolower(dir))
+    {
+    case 'w':
+    case 'i':
+        return 'i';
+    case 'a':
+    case 'j':
+        return 'j';
+    case 's':
+    case 'k':
+        return 'k';
+    case 'd':
+    case 'l':
+        return 'l';
+    }
+    return 0;
+}
@@ -0,0 +1,123 @@
+#ifndef MOVEENGINE_H_INCLUDED
+#define MOVEENGINE_H_INCLUDED
+
+#include "PackedBoard.h"
+#include "Board.h"
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+// A move together with what merged during it
+struct MoveResult
+{
+    PackedBoard board;        // Board after the move
+    bool changed;             // Whether any tile moved
+    int merges;               // Number of merges
+    uint8_t mergedCodes[16];  // How many merges produced each tile code
+};
+
+/**
+ * @class MoveEngine
+ * @brief Table-driven slide and merge for packed boards, shared by the game and both AIs.
+ *        Every possible line of 4-bit codes is moved once when the engine is built,
+ *        so a whole move is one lookup per row or column.
+ */
+class MoveEngine
+{
+private:
+    BoardLayout layout;          // Cell layout of the boards being moved
+    vector<uint32_t> leftTable;  // Line result when tiles slide towards nibble 0
+    vector<uint32_t> rightTable; // Line result when tiles slide towards the last nibble
+    vector<uint32_t> leftMerges;  // Merges of a line sliding towards nibble 0: count in bits 0-3,
+                                  // then the code each merge produced, 4 bits apiece
+    vector<uint32_t> rightMerges; // Same for lines sliding towards the last nibble
+
+    // Slides and merges one line towards index 0 by the game's rules: tiles are taken from
+    // the leading end, and each one passes over empty cells and cells equal to itself, then
+    // halves the tile it stops on if that tile is equal. Returns the merge record
+    static uint32_t slideLine(int* cells, int length);
+
+    // Adds the merges of one line to a result
+    static void addMerges(MoveResult& result, uint32_t record)
+    {
+        int count = record & 0xF;
+        result.merges += count;
+        for (int k = 0; k < count; k++)
+            result.mergedCodes[(record >> (4 + k * 4)) & 0xF]++;
+    }
+
+    // Fills both lookup tables for every possible line
+    void buildTables();
+
+    // Moves every row through a table
+    template <int N>
+    static PackedBoard moveRows(const PackedBoard& b, const uint32_t* table)
+    {
+        PackedBoard result = b;
+        for (int r = 0; r < N; r++)
+            Board<N>::setRow(result, r, table[Board<N>::getRow(b, r)]);
+        return result;
+    }
+
+    // Moves every column through a table by gathering each column into a line
+    template <int N>
+    static PackedBoard moveCols(const PackedBoard& b, const uint32_t* table)
+    {
+        uint32_t rows[N], cols[N] = {};
+        for (int r = 0; r < N; r++)
+        {
+            rows[r] = Board<N>::getRow(b, r);
+            for (int c = 0; c < N; c++)
+                cols[c] |= ((rows[r] >> (c * 4)) & 0xF) << (r * 4);
+        }
+
+        PackedBoard result = b;
+        for (int c = 0; c < N; c++)
+            cols[c] = table[cols[c]];
+        for (int r = 0; r < N; r++)
+        {
+            uint32_t row = 0;
+            for (int c = 0; c < N; c++)
+                row |= ((cols[c] >> (r * 4)) & 0xF) << (c * 4);
+            Board<N>::setRow(result, r, row);
+        }
+        return result;
+    }
+
+    // Builds the tables for the given grid size
+    explicit MoveEngine(int size);
+
+public:
+    // Returns the shared engine for a grid size, building it on first use
+    static const MoveEngine& forSize(int size);
+
+    // Moves a board in direction i/j/k/l; the result equals the input if nothing moved
+    PackedBoard move(const PackedBoard& b, char dir) const;
+
+    // Moves a board and reports the merges in the same pass
+    MoveResult moveWithMerges(const PackedBoard& b, char dir) const;
+
+    // Maps the game's direction keys (w/a/s/d or i/j/k/l, any case) to i/j/k/l; 0 if invalid
+    static char toEngineDirection(char dir);
+
+    // Same move with the grid size fixed at compile time
+    template <int N>
+    PackedBoard move(const PackedBoard& b, char dir) const
+    {
+        switch (dir)
+        {
+        case 'j':
+            return moveRows<N>(b, leftTable.data());   // Left
+        case 'l':
+            return moveRows<N>(b, rightTable.data());  // Right
+        case 'i':
+            return moveCols<N>(b, leftTable.data());   // Up
+        case 'k':
+            return moveCols<N>(b, rightTable.data());  // Down
+        }
+        return b;
+    }
+};
+
+#endif // MOVEENGINE_H_INCLUDED
@@ -0,0 +1,193 @@
+#include "OpeningBook.h"
+#include "ExpectimaxAI.h"
+#include "MoveEngine.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Constructor
+OpeningBook::OpeningBook()
+    : header(), records(nullptr), recordCount(0)
+{
+}
+
+// File name of a book
+string OpeningBook::defaultPath(int size, int startNumber)
+{
+    return "book" + to_string(size) + "x" + to_string(size) + "_" + to_string(startNumber) + ".bin";
+}
+
+// Map each book's file once; a missing file is looked for again next time
+shared_ptr<const OpeningBook> OpeningBook::forSettings(int size, int startNumber)
+{
+    static mutex registryMutex;
+    static map<pair<int, int>, shared_ptr<const OpeningBook>> registry;
+
+    lock_guard<mutex> lock(registryMutex);
+    auto found = registry.find(make_pair(size, startNumber));
+    if (found != registry.end())
+        return found->second;
+
+    string path = defaultPath(size, startNumber);
+    shared_ptr<OpeningBook> book(new OpeningBook());
+    if (!book->file.open(path))
+        return nullptr;
+
+    FileHeader& h = book->header;
+    if (book->file.size() < sizeof(h))
+        throw runtime_error("Malformed opening book file: " + path);
+    memcpy(&h, book->file.data(), sizeof(h));
+    if (h.magic != FILE_MAGIC || h.version != FILE_VERSION || h.gridSize != uint32_t(size) ||
+        h.startNumber != uint32_t(startNumber) ||
+        book->file.size() != sizeof(h) + h.recordCount * sizeof(uint64_t))
+        throw runtime_error("Malformed opening book file: " + path);
+
+    book->records = reinterpret_cast<const uint64_t*>(book->file.data() + sizeof(h));
+    book->recordCount = size_t(h.recordCount);
+    registry[make_pair(size, startNumber)] = book;
+    return book;
+}
+
+// Walk the plies breadth-first: search each new position, play its move, and queue every
+// spawn that leaves the game running. Positions that are the same up to a folded symmetry
+// are searched once
+size_t OpeningBook::build(int size, int startNumber, int plies, int depth, int threads,
+                          const string& path, ostream& log)
+{
+    if (size < 3 || size > 5)
+        throw invalid_argument("Grid size must be between 3 and 5");
+    if (startNumber != 128 && startNumber != 256 && startNumber != 512)
+        throw invalid_argument("Number must be 128, 256, or 512");
+
+    auto buildStart = chrono::steady_clock::now();
+    vector<vector<int>> grid(size, vector<int>(size, -1));
+    Position position = {0, 0};
+    ExpectimaxAI ai(grid, position, size, startNumber, depth, -1);
+    ai.setThreadCount(threads > 0 ? threads : max(1, int(thread::hardware_concurrency())));
+    ai.setTablebaseProbing(false);
+    ai.setOpeningBookProbing(false);
+
+    const BoardLayout layout(size);
+    const MoveEngine& engine = MoveEngine::forSize(size);
+    const BoardSymmetry& symmetry = ai.symmetry;
+    const char directions[4] = {'i', 'j', 'k', 'l'};
+    const int startCode = BoardLayout::toCode(startNumber, -1);
+    const int winCode = BoardLayout::toCode(2, -1);
+
+    vector<PackedBoard> frontier;
+    unordered_set<uint64_t> seen;
+    auto addPosition = [&](const PackedBoard& b)
+    {
+        SymmetricHash hash;
+        symmetry.hash(b, hash);
+        if (seen.insert(symmetry.canonical(hash)).second)
+            frontier.push_back(b);
+    };
+
+    // The opening tiles land on two different cells
+    for (int a = 0; a < size * size; a++)
+    {
+        for (int b = a + 1; b < size * size; b++)
+        {
+            PackedBoard opening = {0, 0};
+            layout.setCell(opening, a / size, a % size, startCode);
+            layout.setCell(opening, b / size, b % size, startCode);
+            addPosition(opening);
+        }
+    }
+
+    vector<uint64_t> bookRecords;
+    for (int ply = 0; ply < plies && !frontier.empty(); ply++)
+    {
+        vector<PackedBoard> positions;
+        positions.swap(frontier);
+        auto plyStart = chrono::steady_clock::now();
+        for (const PackedBoard& b : positions)
+        {
+            layout.unpack(b, grid, -1);
+            char move = ai.getBestMove();
+            if (move == 'n') continue;
+
+            // Store the move as it appears on the canonical image
+            SymmetricHash hash;
+            symmetry.hash(b, hash);
+            char imageMove = BoardSymmetry::mapDirection(symmetry.canonicalSymmetry(hash), move);
+            uint64_t moveIndex = strchr(directions, imageMove) - directions;
+            bookRecords.push_back((symmetry.canonical(hash) & ~MOVE_MASK) | moveIndex);
+            if (ply + 1 == plies) continue;
+
+            // A merge into a 2 ends the game; otherwise every spawn is a position of the next ply
+            PackedBoard moved = engine.move(b, move);
+            bool won = false;
+            for (int cell = 0; cell < size * size; cell++)
+                won = won || layout.getCell(moved, cell / size, cell % size) == winCode;
+            if (won) continue;
+            for (int cell = 0; cell < size * size; cell++)
+            {
+                if (layout.getCell(moved, cell / size, cell % size) != 0) continue;
+                for (int code : ai.possibleSpawnCodes)
+                {
+                    PackedBoard spawned = moved;
+                    layout.setCell(spawned, cell / size, cell % size, code);
+                    if (!ai.checkGameOver(spawned))
+                        addPosition(spawned);
+                }
+            }
+        }
+        log << size << "x" << size << " book for " << startNumber << ": ply " << ply + 1 << ", "
+            << positions.size() << " positions searched in "
+            << chrono::duration<double>(chrono::steady_clock::now() - plyStart).count() << " s" << endl;
+    }
+    sort(bookRecords.begin(), bookRecords.end());
+
+    // Write beside the old book and swap it in, so a process mapping the old file keeps it intact
+    FileHeader header = {FILE_MAGIC, FILE_VERSION, uint32_t(size), uint32_t(startNumber), uint32_t(depth),
+                         uint32_t(plies), uint32_t(symmetry.getActiveCount()), ai.evalWeights.tile,
+                         ai.evalWeights.empty, ai.evalWeights.merge, ai.evalWeights.decay,
+                         uint64_t(bookRecords.size())};
+    string temporaryPath = path + ".tmp";
+    ofstream out(temporaryPath, ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(bookRecords.data()), bookRecords.size() * sizeof(uint64_t));
+    out.close();
+    if (!out)
+        throw runtime_error("Cannot write opening book file: " + temporaryPath);
+    remove(path.c_str());
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+        throw runtime_error("Cannot write opening book file: " + path);
+
+    log << size << "x" << size << " book for " << startNumber << ": " << bookRecords.size()
+        << " positions at depth " << depth << ", written to " << path << " in "
+        << chrono::duration<double>(chrono::steady_clock::now() - buildStart).count() << " s" << endl;
+    return bookRecords.size();
+}
+
+// Book moves replace the search only where they are at least as good as it would be
+bool OpeningBook::covers(int maxDepth, const EvalWeights& weights, int symmetryCount) const
+{
+    EvalWeights bookWeights = {header.tileWeight, header.emptyWeight, header.mergeWeight, header.decay};
+    return int(header.depth) >= maxDepth && bookWeights == weights &&
+           int(header.symmetryCount) == symmetryCount;
+}
+
+// Binary search on the canonical hash, then map the stored move back onto the board
+bool OpeningBook::probe(const SymmetricHash& hash, const BoardSymmetry& symmetry, char& bestMove) const
+{
+    uint64_t key = symmetry.canonical(hash) & ~MOVE_MASK;
+    const uint64_t* end = records + recordCount;
+    const uint64_t* found = lower_bound(records, end, key);
+    if (found == end || (*found & ~MOVE_MASK) != key)
+        return false;
+
+    const char directions[4] = {'i', 'j', 'k', 'l'};
+    bestMove = BoardSymmetry::unmapDirection(symmetry.canonicalSymmetry(hash), directions[*found & MOVE_MASK]);
+    return true;
+}
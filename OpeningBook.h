@@ -0,0 +1,77 @@
+#ifndef OPENINGBOOK_H_INCLUDED
+#define OPENINGBOOK_H_INCLUDED
+
+#include "BoardSymmetry.h"
+#include "MappedFile.h"
+#include "EvalWeights.h"
+#include <cstdint>
+#include <string>
+#include <memory>
+#include <ostream>
+
+using namespace std;
+
+/**
+ * @class OpeningBook
+ * @brief Precomputed best moves for the first plies of a game of one grid size and start number.
+ *        Every game opens with two start tiles on an empty board, and near-empty boards are the
+ *        most expensive to search, so the builder searches each position the AI can face in
+ *        its first plies once, deeply, ahead of time. The book is one sorted array of 64-bit
+ *        records keyed by the canonical symmetric hash, memory-mapped so a probe is a binary search.
+ */
+class OpeningBook
+{
+private:
+    // Record layout: canonical hash with its low 2 bits replaced by the best move (index into
+    // i/j/k/l) on the canonical image
+    static const uint64_t MOVE_MASK = 3;
+    static const uint64_t FILE_MAGIC = 0x314B423834303252ULL; // "R2048BK1" read little-endian
+    static const uint32_t FILE_VERSION = 2;
+
+    // Start of the file, followed by recordCount records
+    struct FileHeader
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t gridSize;
+        uint32_t startNumber;
+        uint32_t depth;          // Search depth of every book move
+        uint32_t plies;          // Plies from the opening the book covers
+        uint32_t symmetryCount;  // Symmetries folded into the keys
+        double tileWeight, emptyWeight, mergeWeight, decay; // Evaluation weights the moves were searched with
+        uint64_t recordCount;
+    };
+
+    MappedFile file;          // The mapped book file
+    FileHeader header;        // Settings the book was built with
+    const uint64_t* records;  // Records sorted by key
+    size_t recordCount;       // Number of records
+
+    OpeningBook();
+
+public:
+    // Returns the file name the book for a grid size and start number is built into and loaded from
+    static string defaultPath(int size, int startNumber);
+
+    // Returns the shared book for a grid size and start number, mapping its file on first use;
+    // null if the file does not exist. Throws runtime_error if the file is malformed
+    static shared_ptr<const OpeningBook> forSettings(int size, int startNumber);
+
+    // Searches every position the AI can face in its first plies (following its own moves,
+    // over every spawn) at a depth and writes the book to path, reporting progress to log;
+    // threads = 0 uses every core. Returns the number of positions
+    static size_t build(int size, int startNumber, int plies, int depth, int threads,
+                        const string& path, ostream& log);
+
+    // Checks if the book's moves are at least as deep as a search to maxDepth with the same
+    // evaluation and symmetry folding would be
+    bool covers(int maxDepth, const EvalWeights& weights, int symmetryCount) const;
+
+    // Looks a board up by its symmetric hashes; false if it is not in the book
+    bool probe(const SymmetricHash& hash, const BoardSymmetry& symmetry, char& bestMove) const;
+
+    // Returns the number of positions stored
+    size_t size() const { return recordCount; }
+};
+
+#endif // OPENINGBOOK_H_INCLUDED
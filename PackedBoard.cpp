@@ -0,0 +1,54 @@
+#include "PackedBoard.h"
+
+// Constructor
+BoardLayout::BoardLayout(int size)
+    : gridSize(size), rowsInLo(64 / (size * 4))
+{
+}
+
+// Pack a vector grid
+PackedBoard BoardLayout::pack(const vector<vector<int>>& g, int empty) const
+{
+    PackedBoard b = {0, 0};
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            setCell(b, i, j, toCode(g[i][j], empty));
+    return b;
+}
+
+// Unpack into a vector grid
+vector<vector<int>> BoardLayout::unpack(const PackedBoard& b, int empty) const
+{
+    vector<vector<int>> g(gridSize, vector<int>(gridSize, empty));
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            g[i][j] = toValue(getCell(b, i, j), empty);
+    return g;
+}
+
+// Unpack into an existing grid
+void BoardLayout::unpack(const PackedBoard& b, vector<vector<int>>& g, int empty) const
+{
+    for (int i = 0; i < gridSize; i++)
+        for (int j = 0; j < gridSize; j++)
+            g[i][j] = toValue(getCell(b, i, j), empty);
+}
+
+// Tile value to code: empty is 0, 1 is 1, 2 is 2, 4 is 3 ... 512 is 10
+int BoardLayout::toCode(int value, int empty)
+{
+    if (value == empty) return 0;
+    int code = 1;
+    while (value > 1)
+    {
+        value >>= 1;
+        code++;
+    }
+    return code;
+}
+
+// Code to tile value
+int BoardLayout::toValue(int code, int empty)
+{
+    return code == 0 ? empty : 1 << (code - 1);
+}
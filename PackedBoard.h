@@ -0,0 +1,103 @@
+#ifndef PACKEDBOARD_H_INCLUDED
+#define PACKEDBOARD_H_INCLUDED
+
+#include "GridGame.h"
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// A whole grid packed as 4-bit tile codes: 0 is empty, a tile of value v is log2(v) + 1.
+// Rows that fit are stored in lo; on a 5x5 grid the last two rows spill into hi.
+struct PackedBoard
+{
+    uint64_t lo, hi;
+    bool operator==(const PackedBoard& other) const {
+        return lo == other.lo && hi == other.hi;
+    }
+    bool operator!=(const PackedBoard& other) const {
+        return !(*this == other);
+    }
+};
+
+// Describes where each cell of a grid of a given size lives inside a PackedBoard
+class BoardLayout
+{
+private:
+    int gridSize;   // Grid dimensions
+    int rowsInLo;   // How many rows are stored in the low word
+
+    // Returns the word holding the given row and the bit offset of that row inside it
+    uint64_t& rowWord(PackedBoard& b, int row, int& shift) const
+    {
+        if (row < rowsInLo)
+        {
+            shift = row * gridSize * 4;
+            return b.lo;
+        }
+        shift = (row - rowsInLo) * gridSize * 4;
+        return b.hi;
+    }
+    uint64_t rowWord(const PackedBoard& b, int row, int& shift) const
+    {
+        return rowWord(const_cast<PackedBoard&>(b), row, shift);
+    }
+
+public:
+    // Constructor sets up the layout for a square grid of the given size
+    explicit BoardLayout(int size);
+
+    // Returns the grid dimensions
+    int size() const { return gridSize; }
+
+    // Returns the tile code stored at a cell
+    int getCell(const PackedBoard& b, int row, int col) const
+    {
+        int shift;
+        uint64_t word = rowWord(b, row, shift);
+        return (word >> (shift + col * 4)) & 0xF;
+    }
+
+    // Stores a tile code at a cell
+    void setCell(PackedBoard& b, int row, int col, int code) const
+    {
+        int shift;
+        uint64_t& word = rowWord(b, row, shift);
+        shift += col * 4;
+        word = (word & ~(0xFULL << shift)) | (uint64_t(code) << shift);
+    }
+
+    // Returns the codes of a whole row, column 0 in the lowest nibble
+    uint32_t getRow(const PackedBoard& b, int row) const
+    {
+        int shift;
+        uint64_t word = rowWord(b, row, shift);
+        return (word >> shift) & ((1ULL << (gridSize * 4)) - 1);
+    }
+
+    // Replaces the codes of a whole row
+    void setRow(PackedBoard& b, int row, uint32_t bits) const
+    {
+        int shift;
+        uint64_t& word = rowWord(b, row, shift);
+        uint64_t mask = ((1ULL << (gridSize * 4)) - 1) << shift;
+        word = (word & ~mask) | (uint64_t(bits) << shift);
+    }
+
+    // Converts a vector grid into its packed form
+    PackedBoard pack(const vector<vector<int>>& g, int empty) const;
+
+    // Converts a packed board back into a vector grid
+    vector<vector<int>> unpack(const PackedBoard& b, int empty) const;
+
+    // Writes a packed board into an existing vector grid of the right size
+    void unpack(const PackedBoard& b, vector<vector<int>>& g, int empty) const;
+
+    // Maps a tile value to its 4-bit code
+    static int toCode(int value, int empty);
+
+    // Maps a 4-bit code back to its tile value
+    static int toValue(int code, int empty);
+};
+
+#endif // PACKEDBOARD_H_INCLUDED
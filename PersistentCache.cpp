@@ -0,0 +1,162 @@
+#include "PersistentCache.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <tuple>
+
+// Constructor
+PersistentCache::PersistentCache()
+    : cacheSettings(), slots(nullptr), slotMask(0), recordCount(0)
+{
+}
+
+// File name of a cache
+string PersistentCache::defaultPath(int size, int startNumber)
+{
+    return "cache" + to_string(size) + "x" + to_string(size) + "_" + to_string(startNumber) + ".bin";
+}
+
+// Map a file and check its header
+shared_ptr<PersistentCache> PersistentCache::open(const string& path)
+{
+    shared_ptr<PersistentCache> cache(new PersistentCache());
+    if (!cache->file.open(path))
+        return nullptr;
+
+    FileHeader header;
+    if (cache->file.size() < sizeof(header))
+        throw runtime_error("Malformed search cache file: " + path);
+    memcpy(&header, cache->file.data(), sizeof(header));
+    if (header.magic != FILE_MAGIC || header.version != FILE_VERSION || header.slotCount == 0 ||
+        (header.slotCount & (header.slotCount - 1)) != 0 || header.recordCount >= header.slotCount ||
+        cache->file.size() != sizeof(header) + header.slotCount * sizeof(CacheRecord))
+        throw runtime_error("Malformed search cache file: " + path);
+
+    cache->cacheSettings = {int(header.gridSize), int(header.startNumber), int(header.symmetryCount),
+                            {header.tileWeight, header.emptyWeight, header.mergeWeight, header.decay}};
+    cache->slots = reinterpret_cast<const CacheRecord*>(cache->file.data() + sizeof(header));
+    cache->slotMask = header.slotCount - 1;
+    cache->recordCount = size_t(header.recordCount);
+    return cache;
+}
+
+// Map each cache file once; a missing file is looked for again next time
+shared_ptr<const PersistentCache> PersistentCache::forSettings(int size, int startNumber)
+{
+    static mutex registryMutex;
+    static map<pair<int, int>, shared_ptr<const PersistentCache>> registry;
+
+    lock_guard<mutex> lock(registryMutex);
+    auto found = registry.find(make_pair(size, startNumber));
+    if (found != registry.end())
+        return found->second;
+
+    string path = defaultPath(size, startNumber);
+    shared_ptr<PersistentCache> cache = open(path);
+    if (!cache)
+        return nullptr;
+    if (cache->cacheSettings.gridSize != size || cache->cacheSettings.startNumber != startNumber)
+        throw runtime_error("Malformed search cache file: " + path);
+    registry[make_pair(size, startNumber)] = cache;
+    return cache;
+}
+
+// Order by node. Every value is searched to exactly its depth, but a folded mirror image sums
+// its spawns in another order, so copies can differ in the last bits; keeping the smallest makes
+// the file the same whatever order the runs came in
+void PersistentCache::compact(vector<CacheRecord>& records)
+{
+    auto node = [](const CacheRecord& r) { return make_tuple(r.key, r.depth, r.type); };
+    sort(records.begin(), records.end(), [&](const CacheRecord& a, const CacheRecord& b)
+    {
+        return make_tuple(node(a), a.value) < make_tuple(node(b), b.value);
+    });
+    records.erase(unique(records.begin(), records.end(), [&](const CacheRecord& a, const CacheRecord& b)
+    {
+        return node(a) == node(b);
+    }), records.end());
+}
+
+// Lay the records out in a table at most half full, write it beside the target and swap it in,
+// so a process mapping the old file keeps it intact
+size_t PersistentCache::write(const string& path, CacheRun& run)
+{
+    compact(run.records);
+    uint64_t slotCount = 16;
+    while (slotCount < 2 * run.records.size())
+        slotCount *= 2;
+
+    vector<CacheRecord> table(slotCount, CacheRecord{0, 0.0, EMPTY_SLOT, 0});
+    for (const CacheRecord& r : run.records)
+    {
+        uint64_t i = r.key & (slotCount - 1);
+        while (table[i].depth != EMPTY_SLOT)
+            i = (i + 1) & (slotCount - 1);
+        table[i] = r;
+    }
+
+    const CacheSettings& s = run.settings;
+    FileHeader header = {FILE_MAGIC, FILE_VERSION, uint32_t(s.gridSize), uint32_t(s.startNumber),
+                         uint32_t(s.symmetryCount), s.weights.tile, s.weights.empty, s.weights.merge,
+                         s.weights.decay, slotCount, uint64_t(run.records.size())};
+    string temporaryPath = path + ".tmp";
+    ofstream out(temporaryPath, ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(CacheRecord));
+    out.close();
+    if (!out)
+        throw runtime_error("Cannot write search cache file: " + temporaryPath);
+    remove(path.c_str());
+    if (rename(temporaryPath.c_str(), path.c_str()) != 0)
+        throw runtime_error("Cannot write search cache file: " + path);
+    return run.records.size();
+}
+
+// Group the runs by grid size and start number and rewrite each group's cache file with the
+// union of its old values and the runs' values
+void PersistentCache::merge(const vector<string>& runPaths, ostream& log)
+{
+    map<pair<int, int>, CacheRun> merged;
+    for (const string& runPath : runPaths)
+    {
+        shared_ptr<PersistentCache> run = open(runPath);
+        if (!run)
+            throw runtime_error("Cannot open search cache run: " + runPath);
+
+        const CacheSettings& s = run->cacheSettings;
+        auto inserted = merged.emplace(make_pair(s.gridSize, s.startNumber), CacheRun{s, {}});
+        CacheRun& target = inserted.first->second;
+        if (inserted.second)
+        {
+            // Start from the values already in the cache file
+            shared_ptr<PersistentCache> existing = open(defaultPath(s.gridSize, s.startNumber));
+            if (existing && existing->cacheSettings != s)
+                throw runtime_error("Search cache run " + runPath + " was made with other settings than " +
+                                    defaultPath(s.gridSize, s.startNumber));
+            for (uint64_t i = 0; existing && i <= existing->slotMask; i++)
+                if (existing->slots[i].depth != EMPTY_SLOT)
+                    target.records.push_back(existing->slots[i]);
+        }
+        else if (target.settings != s)
+        {
+            throw runtime_error("Search cache run " + runPath + " was made with other settings than " +
+                                "the runs before it");
+        }
+
+        for (uint64_t i = 0; i <= run->slotMask; i++)
+            if (run->slots[i].depth != EMPTY_SLOT)
+                target.records.push_back(run->slots[i]);
+        compact(target.records);
+    }
+
+    for (auto& group : merged)
+    {
+        string path = defaultPath(group.first.first, group.first.second);
+        size_t values = write(path, group.second);
+        log << "Search cache " << path << ": " << values << " values" << endl;
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef PERSISTENTCACHE_H_INCLUDED
+#define PERSISTENTCACHE_H_INCLUDED
+
+#include "MappedFile.h"
+#include "EvalWeights.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <ostream>
+
+using namespace std;
+
+// One searched node value: the same fields the in-memory transposition table keeps
+struct CacheRecord
+{
+    uint64_t key;   // Canonical symmetric hash of the board
+    double value;   // Expectimax value
+    uint32_t depth; // Depth the value was searched to
+    uint32_t type;  // TranspositionTable::NodeType
+};
+
+// What cached values depend on; values are only comparable between equal settings
+struct CacheSettings
+{
+    int gridSize;
+    int startNumber;
+    int symmetryCount;  // Symmetries folded into the keys
+    EvalWeights weights; // Evaluation weights
+
+    bool operator==(const CacheSettings& other) const
+    {
+        return gridSize == other.gridSize && startNumber == other.startNumber &&
+               symmetryCount == other.symmetryCount && weights == other.weights;
+    }
+    bool operator!=(const CacheSettings& other) const { return !(*this == other); }
+};
+
+// Values gathered from finished searches, to be written out as one run file
+struct CacheRun
+{
+    CacheSettings settings;
+    vector<CacheRecord> records;
+};
+
+/**
+ * @class PersistentCache
+ * @brief Search values kept on disk between runs, read-only while searching.
+ *        The file is an open-addressed hash table of CacheRecords, twice as many slots as
+ *        records, so it is memory-mapped and probed in place; nothing is parsed at startup.
+ *        Runs write the values their searches found to run files in the same format, and
+ *        merge folds those into the cache file offline.
+ */
+class PersistentCache
+{
+private:
+    static const uint32_t EMPTY_SLOT = 0xFFFFFFFFu; // Depth of a slot that holds no record
+    static const uint64_t FILE_MAGIC = 0x3143533834303252ULL; // "R2048SC1" read little-endian
+    static const uint32_t FILE_VERSION = 2;
+
+    // Start of the file, followed by slotCount slots
+    struct FileHeader
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t gridSize;
+        uint32_t startNumber;
+        uint32_t symmetryCount;
+        double tileWeight, emptyWeight, mergeWeight, decay;
+        uint64_t slotCount;    // Power of two
+        uint64_t recordCount;  // Slots in use
+    };
+
+    MappedFile file;            // The mapped cache file
+    CacheSettings cacheSettings; // Settings the values were searched with
+    const CacheRecord* slots;   // The hash table
+    uint64_t slotMask;          // slotCount - 1
+    size_t recordCount;         // Slots in use
+
+    PersistentCache();
+
+    // Maps a cache or run file; null if it does not exist. Throws runtime_error if it is malformed
+    static shared_ptr<PersistentCache> open(const string& path);
+
+public:
+    // Values searched less deeply are cheaper to search again than to fetch from disk,
+    // so they are neither stored nor looked up
+    static const int MIN_DEPTH = 2;
+
+    // Returns the file name the cache for a grid size and start number is loaded from
+    static string defaultPath(int size, int startNumber);
+
+    // Returns the shared cache for a grid size and start number, mapping its file on first use;
+    // null if the file does not exist. Throws runtime_error if the file is malformed
+    static shared_ptr<const PersistentCache> forSettings(int size, int startNumber);
+
+    // Returns the settings the values were searched with
+    const CacheSettings& settings() const { return cacheSettings; }
+
+    // Looks a node up; false if it is not stored. The scan stops after one lap, so a damaged
+    // file without an empty slot cannot hang it
+    bool probe(uint64_t key, int depth, uint32_t type, double& value) const
+    {
+        uint64_t i = key & slotMask;
+        for (uint64_t scanned = 0; scanned <= slotMask; scanned++, i = (i + 1) & slotMask)
+        {
+            const CacheRecord& r = slots[i];
+            if (r.depth == EMPTY_SLOT)
+                return false;
+            if (r.key == key && r.depth == uint32_t(depth) && r.type == type)
+            {
+                value = r.value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns the number of values stored
+    size_t size() const { return recordCount; }
+
+    // Sorts a run's records and drops repeated nodes, keeping the smallest of their values
+    static void compact(vector<CacheRecord>& records);
+
+    // Writes a run (or a whole cache) as a hash table file; returns the number of values written
+    static size_t write(const string& path, CacheRun& run);
+
+    // Folds run files into the cache files of their grid sizes and start numbers, reporting
+    // to log. Throws runtime_error if a run's settings differ from its existing cache file's
+    static void merge(const vector<string>& runPaths, ostream& log);
+};
+
+#endif // PERSISTENTCACHE_H_INCLUDED
@@ -0,0 +1,62 @@
+#include "SearchStats.h"
+#include <iomanip>
+
+// Total nodes
+long long SearchStats::totalNodes() const
+{
+    long long nodes = 0;
+    for (long long n : maxNodes) nodes += n;
+    for (long long n : chanceNodes) nodes += n;
+    return nodes;
+}
+
+// Report; the stream's format flags and precision are restored afterwards
+void SearchStats::print(ostream& out) const
+{
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << fixed << setprecision(1);
+
+    if (tablebaseHit)
+        out << "Tablebase: win probability " << 100.0 * winProbability << "%, " << totalMs << " ms\n";
+    else if (openingBookHit)
+        out << "Opening book move, " << totalMs << " ms\n";
+    else if (ponderHit)
+        out << "Pondered move, " << totalMs << " ms\n";
+    else
+        printSearch(out);
+
+    out.flags(flags);
+    out.precision(precision);
+}
+
+// Report of a search that ran, on a stream already set to fixed notation
+void SearchStats::printSearch(ostream& out) const
+{
+    out << "Search: depth " << completedDepth << ", " << totalNodes() << " nodes, "
+        << setprecision(1) << totalMs << " ms";
+    if (totalMs > 0)
+        out << " (" << setprecision(0) << totalNodes() / totalMs * 1000.0 << " nodes/s)";
+    out << "\n";
+
+    out << "  nodes by depth (max/chance):";
+    for (int d = int(maxNodes.size()) - 1; d >= 0; d--)
+        if (maxNodes[d] || chanceNodes[d])
+            out << " " << d << ":" << maxNodes[d] << "/" << chanceNodes[d];
+    out << "\n";
+
+    out << "  leaves " << leafEvaluations << ", pruned " << prunedNodes << "\n";
+    out << "  cache probes " << cacheProbes << ", hits " << cacheHits;
+    if (cacheProbes > 0)
+        out << " (" << setprecision(1) << 100.0 * cacheHits / cacheProbes << "%)";
+    if (persistentCacheHits > 0)
+        out << ", from disk " << persistentCacheHits;
+    out << ", stores " << cacheStores << ", evictions " << cacheEvictions
+        << ", used " << usedCacheBytes / 1024 << "/" << cacheCapacityBytes / 1024 << " KiB\n";
+
+    const char directions[4] = {'i', 'j', 'k', 'l'};
+    out << "  time per direction:";
+    for (int d = 0; d < 4; d++)
+        out << " " << directions[d] << "=" << setprecision(1) << directionMs[d] << "ms";
+    out << "\n";
+}
@@ -0,0 +1,43 @@
+#ifndef SEARCHSTATS_H_INCLUDED
+#define SEARCHSTATS_H_INCLUDED
+
+#include <vector>
+#include <ostream>
+#include <cstddef>
+
+using namespace std;
+
+// What one ExpectimaxAI::getBestMove did, summed over all search threads
+struct SearchStats
+{
+    vector<long long> maxNodes;    // Max nodes visited, indexed by remaining depth
+    vector<long long> chanceNodes; // Chance nodes visited, indexed by remaining depth
+    long long leafEvaluations;     // evaluateGrid calls at leaves, terminal and cut nodes
+    long long cacheProbes;         // Transposition table lookups
+    long long cacheHits;           // Lookups that returned a value
+    long long persistentCacheHits; // Hits answered by the on-disk cache, included in cacheHits
+    long long cacheStores;         // Values written to the table
+    long long cacheEvictions;      // Stores that overwrote a different node's value
+    long long prunedNodes;         // Nodes cut by the probability threshold
+    size_t usedCacheBytes;         // Bytes of the table holding values after the search
+    size_t cacheCapacityBytes;     // Bytes allocated for the table
+    double directionMs[4];         // Wall time spent searching i, j, k and l
+    double totalMs;                // Wall time of the whole search
+    int completedDepth;            // Depth of the deepest finished iteration
+    bool tablebaseHit;             // The move came from the 3x3 tablebase and no search ran
+    double winProbability;         // Exact win probability of the position on a tablebase hit
+    bool openingBookHit;           // The move came from the opening book and no search ran
+    bool ponderHit;                // The move was searched in the background before it was asked for
+
+    // Returns max plus chance nodes over all depths
+    long long totalNodes() const;
+
+    // Prints a short multi-line report
+    void print(ostream& out) const;
+
+private:
+    // Prints the report of a search that ran
+    void printSearch(ostream& out) const;
+};
+
+#endif // SEARCHSTATS_H_INCLUDED
@@ -2,6 +2,7 @@
 #define SMARTMERGEMAX_H_INCLUDED
 
 #include "GridGame.h"
+#include "MoveEngine.h"
 #include <vector>
 #include <algorithm>
 #include <cmath>
@@ -23,20 +24,8 @@ private:
     const vector<char> DIRECTIONS = {'w', 's', 'a', 'd'};  // up, down, left, right
     const vector<char> PREFERENCE_ORDER = {'w', 'a', 's', 'd'};  // order for tie break
 
-    // Create a copy of the grid for simulation
-    vector<vector<int>> copyGrid(const vector<vector<int>>& original) const;
-
-    // Simulate a move and count merges with weighting
-    pair<vector<vector<int>>, float> simulateMoveAndCountMerges(
-        const vector<vector<int>>& grid,
-        const Position& pos,
-        char direction) const;
-
-    // Modified from simulateProcessMovement to count merges with weights
-    float simulateProcessMovementAndCountMerges(
-        Position& pos,
-        vector<vector<int>>& grid,
-        char dir) const;
+    // Scores the merges of a move with weighting
+    float scoreMerges(const MoveResult& result) const;
 
 public:
     SmartMergeMax(); // Constructor
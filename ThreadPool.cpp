@@ -0,0 +1,198 @@
+#include "ThreadPool.h"
+
+thread_local ThreadPool* ThreadPool::currentPool = nullptr;
+thread_local int ThreadPool::currentQueue = 0;
+
+// Constructor
+ThreadPool::ThreadPool(int threadCount)
+    : queues(new WorkerQueue[max(threadCount, 1)]), queueCount(max(threadCount, 1)),
+      queuedTasks(0), stopping(false)
+{
+    // Every thread starts with a ring and a block of tasks, so even the first search
+    // does not allocate unless it needs more than a block of live tasks per thread
+    for (int i = 0; i < queueCount; i++)
+    {
+        queues[i].ring.resize(TASKS_PER_BLOCK);
+        queues[i].blocks.reserve(16);
+        addTaskBlock(i);
+    }
+    for (int i = 1; i < queueCount; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+// Destructor
+ThreadPool::~ThreadPool()
+{
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+// Own deque of the calling thread
+int ThreadPool::queueIndex() const
+{
+    return currentPool == this ? currentQueue : 0;
+}
+
+// Ring buffer operations
+void ThreadPool::WorkerQueue::pushBack(Task* task)
+{
+    if (count == ring.size())
+    {
+        // Unroll the ring into a buffer twice the size
+        vector<Task*> bigger(max<size_t>(ring.size() * 2, 64));
+        for (size_t k = 0; k < count; k++)
+            bigger[k] = ring[(head + k) % ring.size()];
+        ring.swap(bigger);
+        head = 0;
+    }
+    ring[(head + count) % ring.size()] = task;
+    count++;
+}
+
+ThreadPool::Task* ThreadPool::WorkerQueue::popBack()
+{
+    count--;
+    return ring[(head + count) % ring.size()];
+}
+
+ThreadPool::Task* ThreadPool::WorkerQueue::popFront()
+{
+    Task* task = ring[head];
+    head = (head + 1) % ring.size();
+    count--;
+    return task;
+}
+
+// Newest own task first, otherwise the oldest task of another thread
+ThreadPool::Task* ThreadPool::takeTask(int self)
+{
+    if (queuedTasks.load(memory_order_acquire) == 0) return nullptr;
+
+    {
+        WorkerQueue& own = queues[self];
+        lock_guard<mutex> lock(own.lock);
+        if (own.count != 0)
+        {
+            queuedTasks--;
+            return own.popBack();
+        }
+    }
+
+    for (int i = 1; i < queueCount; i++)
+    {
+        WorkerQueue& victim = queues[(self + i) % queueCount];
+        lock_guard<mutex> lock(victim.lock);
+        if (victim.count != 0)
+        {
+            queuedTasks--;
+            return victim.popFront();
+        }
+    }
+    return nullptr;
+}
+
+// Run a task; it goes back to the free list it came from, so no thread's list drains
+// into another's
+void ThreadPool::execute(Task* task)
+{
+    TaskGroup* group = task->group;
+    task->run(task->storage);
+    {
+        WorkerQueue& owner = queues[task->owner];
+        lock_guard<mutex> lock(owner.lock);
+        task->nextFree = owner.freeTasks;
+        owner.freeTasks = task;
+    }
+    group->pending.fetch_sub(1, memory_order_release);
+}
+
+// New block of tasks owned by a deque
+void ThreadPool::addTaskBlock(int index)
+{
+    WorkerQueue& queue = queues[index];
+    queue.blocks.emplace_back(new Task[TASKS_PER_BLOCK]);
+    Task* block = queue.blocks.back().get();
+    for (int k = 0; k < TASKS_PER_BLOCK; k++)
+    {
+        block[k].owner = index;
+        block[k].nextFree = queue.freeTasks;
+        queue.freeTasks = &block[k];
+    }
+}
+
+// Recycled task, or a fresh block of them
+ThreadPool::Task* ThreadPool::allocateTask()
+{
+    int self = queueIndex();
+    WorkerQueue& own = queues[self];
+    lock_guard<mutex> lock(own.lock);
+    if (!own.freeTasks)
+        addTaskBlock(self);
+    Task* task = own.freeTasks;
+    own.freeTasks = task->nextFree;
+    return task;
+}
+
+// Worker loop
+void ThreadPool::workerLoop(int index)
+{
+    currentPool = this;
+    currentQueue = index;
+    while (!stopping)
+    {
+        Task* task = takeTask(index);
+        if (task)
+        {
+            execute(task);
+            continue;
+        }
+
+        unique_lock<mutex> lock(sleepMutex);
+        workAvailable.wait(lock, [this] { return stopping || queuedTasks > 0; });
+    }
+}
+
+// Queue a task on the caller's deque
+void ThreadPool::enqueue(TaskGroup& group, Task* task)
+{
+    group.pending.fetch_add(1, memory_order_relaxed);
+    task->group = &group;
+    {
+        WorkerQueue& own = queues[queueIndex()];
+        lock_guard<mutex> lock(own.lock);
+        own.pushBack(task);
+    }
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        queuedTasks++;
+    }
+    workAvailable.notify_one();
+}
+
+// Help with queued tasks until the group is done
+void ThreadPool::wait(TaskGroup& group)
+{
+    int self = queueIndex();
+    while (group.pending.load(memory_order_acquire) > 0)
+    {
+        Task* task = takeTask(self);
+        if (task)
+            execute(task);
+        else
+            this_thread::yield();
+    }
+}
+
+// Run a batch from outside or inside the pool
+void ThreadPool::runBatch(vector<function<void()>>& batch)
+{
+    TaskGroup group;
+    for (auto& job : batch)
+        spawn(group, move(job));
+    wait(group);
+}
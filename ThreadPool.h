@@ -0,0 +1,129 @@
+#ifndef THREADPOOL_H_INCLUDED
+#define THREADPOOL_H_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <utility>
+
+using namespace std;
+
+/**
+ * @class ThreadPool
+ * @brief Persistent work-stealing scheduler.
+ *        Every thread owns a deque: it pushes and pops its own tasks at the back
+ *        and steals the oldest (largest) tasks from the front of other deques.
+ *        A thread waiting for a task group keeps running tasks instead of blocking,
+ *        so tasks may spawn and wait for subtasks at any nesting level.
+ *        Tasks hold their job inline and go back to the free list of the thread that
+ *        spawned them, so once the pool has warmed up spawning a task does not touch the heap.
+ */
+class ThreadPool
+{
+public:
+    // Counts the unfinished tasks spawned into it
+    class TaskGroup
+    {
+        friend class ThreadPool;
+        atomic<int> pending{0};
+    };
+
+private:
+    static const int TASK_STORAGE = 128; // Bytes of captured state a job can hold inline
+    static const int TASKS_PER_BLOCK = 64; // Tasks allocated at once when a free list runs dry
+
+    struct Task
+    {
+        alignas(16) unsigned char storage[TASK_STORAGE]; // The job object
+        void (*run)(void* job);   // Calls the job and destroys it
+        TaskGroup* group;
+        int owner;                // Deque whose free list the task returns to
+        Task* nextFree;           // Link while the task sits in a free list
+    };
+
+    struct WorkerQueue
+    {
+        mutex lock;
+        vector<Task*> ring;       // Circular buffer of queued tasks; grows, never shrinks
+        size_t head = 0;          // Index of the oldest task in ring
+        size_t count = 0;         // Number of queued tasks
+        Task* freeTasks = nullptr; // Recycled tasks for this thread to spawn into
+        vector<unique_ptr<Task[]>> blocks; // Storage of every task this thread allocated
+
+        // Queue operations on the ring, called with lock held
+        void pushBack(Task* task);
+        Task* popBack();
+        Task* popFront();
+    };
+
+    vector<thread> workers;             // Background worker threads
+    unique_ptr<WorkerQueue[]> queues;   // One deque per thread; queue 0 belongs to the caller
+    int queueCount;                     // Number of deques
+    atomic<int> queuedTasks;            // Tasks sitting in any deque
+    mutex sleepMutex;                   // Guards idle workers going to sleep
+    condition_variable workAvailable;   // Wakes idle workers when tasks are spawned
+    atomic<bool> stopping;              // Set when the pool shuts down
+
+    static thread_local ThreadPool* currentPool; // Pool the current thread works for
+    static thread_local int currentQueue;        // Deque of the current thread in that pool
+
+    // Takes a task from the own deque, or steals one from another deque
+    Task* takeTask(int self);
+
+    // Runs a task, marks it finished in its group and recycles it
+    void execute(Task* task);
+
+    // Adds a block of fresh tasks to a deque's free list, called with its lock held
+    void addTaskBlock(int index);
+
+    // Takes a recycled task for the calling thread, allocating a block if none is left
+    Task* allocateTask();
+
+    // Queues a filled task on the calling thread's deque
+    void enqueue(TaskGroup& group, Task* task);
+
+    // Worker loop: run and steal tasks until the pool stops
+    void workerLoop(int index);
+
+public:
+    // Constructor starts threadCount - 1 background workers
+    explicit ThreadPool(int threadCount);
+
+    // Destructor stops and joins the workers
+    ~ThreadPool();
+
+    // Returns the number of threads working on tasks, including the caller
+    int size() const { return queueCount; }
+
+    // Returns the index (0 to size() - 1) of the calling thread; 0 for a thread outside the pool
+    int queueIndex() const;
+
+    // Queues a task on the calling thread's deque; the job is stored inside the task
+    template <typename F>
+    void spawn(TaskGroup& group, F job)
+    {
+        static_assert(sizeof(F) <= TASK_STORAGE && alignof(F) <= 16, "Job too large for a task");
+        Task* task = allocateTask();
+        new (task->storage) F(move(job));
+        task->run = [](void* stored)
+        {
+            F* f = static_cast<F*>(stored);
+            (*f)();
+            f->~F();
+        };
+        enqueue(group, task);
+    }
+
+    // Runs tasks until every task of the group has finished
+    void wait(TaskGroup& group);
+
+    // Runs every job and returns once all of them have finished
+    void runBatch(vector<function<void()>>& batch);
+};
+
+#endif // THREADPOOL_H_INCLUDED
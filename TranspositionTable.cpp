@@ -0,0 +1,168 @@
+#include "TranspositionTable.h"
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// Bit-for-bit conversions between a value and its stored form
+static uint64_t valueBits(double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static double bitsValue(uint64_t bits)
+{
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Constructor
+TranspositionTable::TranspositionTable(int sizeBits)
+    : entryCount(0), generation(0), usedEntries(0)
+{
+    resize(sizeBits);
+}
+
+// Resize the table
+void TranspositionTable::resize(int sizeBits)
+{
+    if (sizeBits < 1 || sizeBits > 30)
+        throw invalid_argument("Cache size must be between 2^1 and 2^30 entries");
+    entryCount = size_t(1) << sizeBits;
+    entries.reset(new Entry[entryCount]);
+    bucketMask = (uint64_t(1) << (sizeBits - 1)) - 1;
+    clear();
+}
+
+// Clear all entries
+void TranspositionTable::clear()
+{
+    for (size_t i = 0; i < entryCount; i++)
+    {
+        entries[i].check.store(0, memory_order_relaxed);
+        entries[i].value.store(0, memory_order_relaxed);
+        entries[i].meta.store(0, memory_order_relaxed);
+    }
+    usedEntries = 0;
+}
+
+// Read and verify a slot
+TranspositionTable::Slot TranspositionTable::readSlot(const Entry& e, uint64_t key) const
+{
+    uint64_t check = e.check.load(memory_order_relaxed);
+    uint64_t bits = e.value.load(memory_order_relaxed);
+    uint32_t meta = e.meta.load(memory_order_relaxed);
+    Slot slot;
+    slot.valid = (meta & 0xFF) != 0 && (check ^ bits ^ meta) == key;
+    slot.depth = int(meta & 0xFF) - 1;
+    slot.type = (meta >> 8) & 0xFF;
+    slot.generation = (meta >> 16) & 0xFF;
+    slot.reachExponent = (meta >> 24) & 0xFF;
+    slot.value = bitsValue(bits);
+    return slot;
+}
+
+// Write a slot
+void TranspositionTable::writeSlot(Entry& e, uint64_t key, double value, uint32_t meta)
+{
+    uint64_t bits = valueBits(value);
+    e.value.store(bits, memory_order_relaxed);
+    e.meta.store(meta, memory_order_relaxed);
+    e.check.store(key ^ bits ^ meta, memory_order_relaxed);
+}
+
+// Copy a slot as is
+void TranspositionTable::copySlot(Entry& to, const Entry& from)
+{
+    to.value.store(from.value.load(memory_order_relaxed), memory_order_relaxed);
+    to.meta.store(from.meta.load(memory_order_relaxed), memory_order_relaxed);
+    to.check.store(from.check.load(memory_order_relaxed), memory_order_relaxed);
+}
+
+// Round up, clamped to what the meta field holds
+int TranspositionTable::reachExponent(double reach)
+{
+    if (reach >= 1.0) return 0;
+    return min(255, int(ceil(-log2(reach))));
+}
+
+// Next generation; on the wrap to 0 the old tags are moved to 255, one pass every 256 searches
+void TranspositionTable::newSearch()
+{
+    if (++generation != 0) return;
+    for (size_t i = 0; i < entryCount; i++)
+    {
+        uint32_t meta = entries[i].meta.load(memory_order_relaxed);
+        if ((meta & 0xFF) == 0) continue;
+        uint64_t bits = entries[i].value.load(memory_order_relaxed);
+        uint64_t key = entries[i].check.load(memory_order_relaxed) ^ bits ^ meta;
+        writeSlot(entries[i], key, bitsValue(bits), (meta & ~0xFF0000u) | 0xFF0000u);
+    }
+}
+
+// Probe both slots of the bucket. A hit from an earlier move is refreshed to this generation
+bool TranspositionTable::probe(uint64_t key, int depth, NodeType type, int maxReachExponent,
+                               double& value, int& reachExponent)
+{
+    Entry* bucket = &entries[(key & bucketMask) * 2];
+    uint8_t gen = generation.load(memory_order_relaxed);
+    for (int slot = 0; slot < 2; slot++)
+    {
+        Slot s = readSlot(bucket[slot], key);
+        if (!s.valid || s.depth != depth || s.type != type || s.reachExponent > maxReachExponent)
+            continue;
+        if (s.generation != gen)
+            writeSlot(bucket[slot], key, s.value, packMeta(depth, type, gen, s.reachExponent));
+        value = s.value;
+        reachExponent = s.reachExponent;
+        return true;
+    }
+    return false;
+}
+
+// Depth-preferred store: slot 0 keeps the deepest value of the current generation,
+// slot 1 takes everything else
+bool TranspositionTable::store(uint64_t key, int depth, NodeType type, double value, int reachExponent)
+{
+    Entry* bucket = &entries[(key & bucketMask) * 2];
+    uint8_t gen = generation.load(memory_order_relaxed);
+    uint32_t meta = packMeta(depth, type, gen, uint8_t(reachExponent));
+
+    uint32_t meta0 = bucket[0].meta.load(memory_order_relaxed);
+    uint32_t meta1 = bucket[1].meta.load(memory_order_relaxed);
+    bool used0 = (meta0 & 0xFF) != 0, used1 = (meta1 & 0xFF) != 0;
+    int depth0 = int(meta0 & 0xFF) - 1;
+    uint8_t gen0 = (meta0 >> 16) & 0xFF, gen1 = (meta1 >> 16) & 0xFF;
+
+    if (!used0 || gen0 != gen || depth >= depth0)
+    {
+        // Keep the displaced value around in the second slot if it is a different node,
+        // unless that would push out a current value for a stale one
+        Slot same = readSlot(bucket[0], key);
+        bool sameNode = same.valid && same.depth == depth && same.type == type;
+        bool evicted = false;
+        if (used0 && !sameNode)
+        {
+            if (gen0 == gen || gen1 != gen)
+            {
+                evicted = used1;
+                if (!used1) usedEntries++;
+                copySlot(bucket[1], bucket[0]);
+            }
+            else
+            {
+                evicted = true;
+            }
+        }
+        if (!used0) usedEntries++;
+        writeSlot(bucket[0], key, value, meta);
+        return evicted;
+    }
+
+    if (!used1) usedEntries++;
+    writeSlot(bucket[1], key, value, meta);
+    return used1;
+}
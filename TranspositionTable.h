@@ -0,0 +1,122 @@
+#ifndef TRANSPOSITIONTABLE_H_INCLUDED
+#define TRANSPOSITIONTABLE_H_INCLUDED
+
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <cstring>
+
+using namespace std;
+
+/**
+ * @class TranspositionTable
+ * @brief Fixed-size cache of expectimax values keyed by Zobrist hash.
+ *        Each bucket has a depth-preferred slot and an always-replace slot,
+ *        so memory stays at the configured size however long the game runs.
+ *        Values are kept across moves; every entry is tagged with the search
+ *        generation that wrote it so stale entries are the first to be replaced.
+ *        A probe is answered only by a value searched to the same depth, so a value never
+ *        depends on which searches ran before; a later move reuses the nodes it reaches
+ *        again at their own depth. Under a probability cutoff each value also records how unlikely
+ *        the deepest-reaching node that checked the cutoff below it was, as a reach exponent,
+ *        so a probe only takes values that a search along its own path would not have cut.
+ *        Threads share the table without locks: an entry stores key ^ value ^ meta,
+ *        so a slot torn by two concurrent writers fails the check and reads as a miss.
+ */
+class TranspositionTable
+{
+public:
+    // Kind of search node a value belongs to
+    enum NodeType : uint8_t { MAX_NODE = 0, CHANCE_NODE = 1 };
+
+private:
+    struct Entry
+    {
+        atomic<uint64_t> check; // key ^ value bits ^ meta
+        atomic<uint64_t> value; // Bits of the node's expectimax value
+        atomic<uint32_t> meta;  // Depth, node type, generation and reach exponent, see packMeta
+    };
+
+    // Snapshot of one slot after its check has been verified
+    struct Slot
+    {
+        bool valid;
+        int depth;
+        uint8_t type, generation, reachExponent;
+        double value;
+    };
+
+    unique_ptr<Entry[]> entries; // Two slots per bucket
+    size_t entryCount;           // Number of entries
+    uint64_t bucketMask;         // Number of buckets - 1
+    atomic<uint8_t> generation;  // Current search generation
+    atomic<size_t> usedEntries;  // Slots that hold a value
+
+    // Packs depth (stored + 1 so 0 means unused), node type, generation and reach exponent
+    static uint32_t packMeta(int depth, uint8_t type, uint8_t gen, uint8_t reachExponent)
+    {
+        return uint32_t(depth + 1) | (uint32_t(type) << 8) | (uint32_t(gen) << 16) |
+               (uint32_t(reachExponent) << 24);
+    }
+
+    // Reads a slot and verifies it belongs to key
+    Slot readSlot(const Entry& e, uint64_t key) const;
+
+    // Writes a slot
+    static void writeSlot(Entry& e, uint64_t key, double value, uint32_t meta);
+
+    // Copies one slot into another, keeping its own key
+    static void copySlot(Entry& to, const Entry& from);
+
+public:
+    // Constructor allocates 2^sizeBits entries
+    explicit TranspositionTable(int sizeBits);
+
+    // Reallocates the table with 2^sizeBits entries, dropping all values
+    void resize(int sizeBits);
+
+    // Removes every value
+    void clear();
+
+    // Starts a new search generation; older entries become replaceable. When the 8-bit
+    // generation wraps, every entry is retagged as old so none looks current again
+    void newSearch();
+
+    // Reach exponent a value may be stored with: -log2 of reach rounded up, so 2^-exponent
+    // never overstates reach. Values stored without a cutoff have exponent 0
+    static int reachExponent(double reach);
+
+    // Looks up a value searched to depth whose reach exponent is at most maxReachExponent;
+    // returns false on a miss
+    bool probe(uint64_t key, int depth, NodeType type, int maxReachExponent, double& value,
+               int& reachExponent);
+
+    // Stores a value, keeping the deeper current-generation result in the depth-preferred slot;
+    // returns true if another node's value was overwritten
+    bool store(uint64_t key, int depth, NodeType type, double value, int reachExponent = 0);
+
+    // Calls f(key, depth, type, value) for every value held; only while no search is running
+    template <typename F>
+    void forEachValue(F f) const
+    {
+        for (size_t i = 0; i < entryCount; i++)
+        {
+            uint32_t meta = entries[i].meta.load(memory_order_relaxed);
+            if ((meta & 0xFF) == 0) continue;
+            uint64_t bits = entries[i].value.load(memory_order_relaxed);
+            uint64_t key = entries[i].check.load(memory_order_relaxed) ^ bits ^ meta;
+            if ((meta >> 24) != 0) continue; // Only valid along paths likely enough
+            double value;
+            memcpy(&value, &bits, sizeof(value));
+            f(key, int(meta & 0xFF) - 1, NodeType((meta >> 8) & 0xFF), value);
+        }
+    }
+
+    // Returns the memory allocated for the table in bytes
+    size_t sizeInBytes() const { return entryCount * sizeof(Entry); }
+
+    // Returns the memory of the slots that hold a value in bytes
+    size_t usedBytes() const { return usedEntries.load() * sizeof(Entry); }
+};
+
+#endif // TRANSPOSITIONTABLE_H_INCLUDED
@@ -0,0 +1,56 @@
+#include "Zobrist.h"
+#include <random>
+
+// Constructor fills the key table from a fixed seed
+Zobrist::Zobrist()
+{
+    mt19937_64 rng(0x2048D1F1DEULL);
+    for (int cell = 0; cell < MAX_CELLS; cell++)
+    {
+        keys[cell][0] = 0; // Empty cells do not change the hash
+        for (int code = 1; code < 16; code++)
+            keys[cell][code] = rng();
+    }
+}
+
+// Shared key set
+const Zobrist& Zobrist::instance()
+{
+    static const Zobrist zobrist;
+    return zobrist;
+}
+
+// Hash a board from scratch
+uint64_t Zobrist::hash(const PackedBoard& b, const BoardLayout& layout) const
+{
+    uint64_t h = 0;
+    int n = layout.size();
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            h ^= keys[i * n + j][layout.getCell(b, i, j)];
+    return h;
+}
+
+// Incremental update: only nibbles that changed are visited
+uint64_t Zobrist::update(uint64_t hash, const PackedBoard& from, const PackedBoard& to,
+                         const BoardLayout& layout) const
+{
+    // Rows are stored contiguously, so nibble k of lo is cell k and nibble k of hi
+    // continues right after the last cell held in lo
+    const int cellsInLo = (64 / (layout.size() * 4)) * layout.size();
+    for (int word = 0; word < 2; word++)
+    {
+        uint64_t a = word == 0 ? from.lo : from.hi;
+        uint64_t b = word == 0 ? to.lo : to.hi;
+        uint64_t diff = a ^ b;
+        while (diff != 0)
+        {
+            int nibble = __builtin_ctzll(diff) / 4;
+            int shift = nibble * 4;
+            int cell = word == 0 ? nibble : cellsInLo + nibble;
+            hash ^= keys[cell][(a >> shift) & 0xF] ^ keys[cell][(b >> shift) & 0xF];
+            diff &= ~(0xFULL << shift);
+        }
+    }
+    return hash;
+}
@@ -0,0 +1,38 @@
+#ifndef ZOBRIST_H_INCLUDED
+#define ZOBRIST_H_INCLUDED
+
+#include "PackedBoard.h"
+#include <cstdint>
+
+using namespace std;
+
+/**
+ * @class Zobrist
+ * @brief 64-bit Zobrist hashing of packed boards.
+ *        Keys come from a fixed seed so hashes are the same in every run.
+ *        An empty cell contributes nothing, so hashes can be updated one cell at a time.
+ */
+class Zobrist
+{
+private:
+    static const int MAX_CELLS = 25;
+    uint64_t keys[MAX_CELLS][16]; // One key per (cell, tile code)
+
+    Zobrist();
+
+public:
+    // Returns the shared key set
+    static const Zobrist& instance();
+
+    // Returns the key of a tile code on a cell (cell = row * gridSize + col)
+    uint64_t cellKey(int cell, int code) const { return keys[cell][code]; }
+
+    // Hashes a whole board
+    uint64_t hash(const PackedBoard& b, const BoardLayout& layout) const;
+
+    // Updates a hash for the cells that differ between two boards
+    uint64_t update(uint64_t hash, const PackedBoard& from, const PackedBoard& to,
+                    const BoardLayout& layout) const;
+};
+
+#endif // ZOBRIST_H_INCLUDED
@@ -4,14 +4,252 @@
  * This program implements a puzzle game where players(algorithms) control two separate grids,
  * trying to merge numbers to reach the value 2. The game mechanics are similar to 2048
  * but with division instead of multiplication when merging.
+ *
+ * Usage:
+ *   reverse2048 [opts]          play interactively (config from reverse2048.txt)
+ *       --delay MS              auto-play pauses MS ms after each board (default 300, 0 = unthrottled)
+ *       --search-threads 1      threads each Expectimax search runs on
+ *       --depth 7               plies the Expectimax AI searches
+ *       --prob-cutoff 0         lines less likely than this are scored without searching them
+ *       --time-budget 0         ms per move; the AI deepens up to --depth while time is left (0 = no budget)
+ *       --weights 1000,4,10,0.5 Expectimax evaluation weights, e.g. from --tune
+ *   reverse2048 --batch [opts]  play headless games and print statistics
+ *       --sizes 3,4,5  --numbers 128,256,512  --depths 3,5  --ai expectimax,smartmerge
+ *       --games 100  --seed 1  --threads 0 (all cores)  --format csv|json
+ *       --search-threads 1  threads each Expectimax search runs on, besides the games in parallel
+ *       --prob-cutoffs 0,0.001  probability cutoffs to compare; each is a configuration like a depth
+ *       --time-budget 0   ms per Expectimax move, deepening up to each depth (0 = no budget)
+ *       --save-cache DIR  write the Expectimax search values of each configuration to a run file
+ *       --weights 1000,4,10,0.5  Expectimax evaluation weights: tile, empty, merge, decay
+ *   reverse2048 --tune [opts]   tune the Expectimax evaluation weights by self-play and print them
+ *       --size 4  --number 256  --depth 3  --games 100  --iterations 50  --seed 1
+ *       --threads 0 (all cores)  --checkpoint FILE (save progress to and resume from FILE)
+ *   reverse2048 --merge-cache run.bin [run.bin ...]
+ *                               fold run files into cache<size>x<size>_<number>.bin, which
+ *                               the AI then reads its first cache hits from
+ *   reverse2048 --build-tablebase [--numbers 128,256,512]
+ *                               solve 3x3 play exactly and write tablebase3x3_<number>.bin
+ *                               files, which the AI then uses on 3x3 grids
+ *   reverse2048 --build-book [opts]
+ *                               search the first plies of every game once and write
+ *                               book<size>x<size>_<number>.bin files the AI plays openings from
+ *       --sizes 4  --numbers 256  --plies 3  --depth 7  --threads 0 (all cores)
  */
 #include "GridGame.h"
+#include "BatchRunner.h"
+#include "EndgameTablebase.h"
+#include "EvalTuner.h"
+#include "OpeningBook.h"
+#include "PersistentCache.h"
+#include <sstream>
+
+// Splits a comma separated option value
+static vector<string> splitList(const string& value) {
+    vector<string> items;
+    stringstream in(value);
+    string item;
+    while (getline(in, item, ',')) {
+        if (!item.empty()) items.push_back(item);
+    }
+    return items;
+}
+
+// Splits a comma separated list of numbers
+static vector<int> parseNumbers(const string& value) {
+    vector<int> numbers;
+    for (const string& item : splitList(value)) {
+        numbers.push_back(stoi(item));
+    }
+    return numbers;
+}
+
+// Splits a comma separated list of decimal numbers
+static vector<double> parseDecimals(const string& value) {
+    vector<double> decimals;
+    for (const string& item : splitList(value)) {
+        decimals.push_back(stod(item));
+    }
+    return decimals;
+}
+
+// Runs every combination of the batch options and prints the reports
+static int runBatch(int argc, char* argv[]) {
+    vector<int> sizes = {4}, numbers = {256}, depths = {3};
+    vector<double> cutoffs = {0.0};
+    vector<AiType> aiTypes = {AiType::Expectimax};
+    int games = 100, threads = 0;
+    unsigned seed = 1;
+    string format = "csv", cacheDirectory;
+    SearchSettings search;
+
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (i + 1 >= argc) throw invalid_argument("Missing value for " + option);
+        string value = argv[++i];
+
+        if (option == "--sizes") sizes = parseNumbers(value);
+        else if (option == "--numbers") numbers = parseNumbers(value);
+        else if (option == "--depths") depths = parseNumbers(value);
+        else if (option == "--prob-cutoffs") cutoffs = parseDecimals(value);
+        else if (option == "--games") games = stoi(value);
+        else if (option == "--seed") seed = stoul(value);
+        else if (option == "--threads") threads = stoi(value);
+        else if (option == "--format") format = value;
+        else if (option == "--save-cache") cacheDirectory = value;
+        else if (option == "--weights") search.weights = EvalTuner::parseWeights(value);
+        else if (option == "--search-threads") search.threads = stoi(value);
+        else if (option == "--time-budget") search.timeBudgetMs = stoi(value);
+        else if (option == "--ai") {
+            aiTypes.clear();
+            for (const string& name : splitList(value)) {
+                if (name == "expectimax") aiTypes.push_back(AiType::Expectimax);
+                else if (name == "smartmerge") aiTypes.push_back(AiType::SmartMergeMax);
+                else throw invalid_argument("Unknown AI: " + name);
+            }
+        }
+        else throw invalid_argument("Unknown option: " + option);
+    }
+
+    BatchRunner runner(threads);
+    vector<BatchReport> reports;
+    for (int size : sizes)
+        for (int number : numbers)
+            for (AiType type : aiTypes)
+                for (int depth : depths)
+                    for (double cutoff : cutoffs) {
+                        string cacheRunPath;
+                        if (!cacheDirectory.empty()) {
+                            cacheRunPath = cacheDirectory + "/run" + to_string(size) + "x" + to_string(size) + "_" +
+                                           to_string(number) + "_d" + to_string(depth) + "_s" + to_string(seed) +
+                                           (cutoff > 0.0 ? "_c" + to_string(cutoff) : "") + ".bin";
+                        }
+                        search.depth = depth;
+                        search.probabilityCutoff = cutoff;
+                        reports.push_back(runner.run({size, number, type, games, seed, cacheRunPath, search}));
+                    }
+
+    if (format == "json") BatchRunner::writeJson(cout, reports);
+    else BatchRunner::writeCsv(cout, reports);
+    return 0;
+}
+
+// Tunes the evaluation weights and prints them as a --weights value
+static int runTuner(int argc, char* argv[]) {
+    TunerConfig config = {4, 256, 3, 100, 50, 1, 0, ""};
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (i + 1 >= argc) throw invalid_argument("Missing value for " + option);
+        string value = argv[++i];
+
+        if (option == "--size") config.gridSize = stoi(value);
+        else if (option == "--number") config.startNumber = stoi(value);
+        else if (option == "--depth") config.depth = stoi(value);
+        else if (option == "--games") config.games = stoi(value);
+        else if (option == "--iterations") config.iterations = stoi(value);
+        else if (option == "--seed") config.seed = stoul(value);
+        else if (option == "--threads") config.threads = stoi(value);
+        else if (option == "--checkpoint") config.checkpointPath = value;
+        else throw invalid_argument("Unknown option: " + option);
+    }
+
+    EvalTuner tuner(config);
+    EvalWeights weights = tuner.run(cerr);
+    cout << EvalTuner::formatWeights(weights) << endl;
+    return 0;
+}
+
+// Solves the 3x3 game for each start number and writes the tablebase files
+static int buildTablebases(int argc, char* argv[]) {
+    vector<int> numbers = {128, 256, 512};
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (i + 1 >= argc) throw invalid_argument("Missing value for " + option);
+        string value = argv[++i];
+
+        if (option == "--numbers") numbers = parseNumbers(value);
+        else throw invalid_argument("Unknown option: " + option);
+    }
+
+    for (int number : numbers) {
+        EndgameTablebase::build(number, EndgameTablebase::defaultPath(number), cout);
+    }
+    return 0;
+}
+
+// Searches the opening plies for each grid size and start number and writes the books
+static int buildBooks(int argc, char* argv[]) {
+    vector<int> sizes = {4}, numbers = {256};
+    int plies = 3, depth = 7, threads = 0;
+    for (int i = 2; i < argc; i++) {
+        string option = argv[i];
+        if (i + 1 >= argc) throw invalid_argument("Missing value for " + option);
+        string value = argv[++i];
+
+        if (option == "--sizes") sizes = parseNumbers(value);
+        else if (option == "--numbers") numbers = parseNumbers(value);
+        else if (option == "--plies") plies = stoi(value);
+        else if (option == "--depth") depth = stoi(value);
+        else if (option == "--threads") threads = stoi(value);
+        else throw invalid_argument("Unknown option: " + option);
+    }
+
+    for (int size : sizes) {
+        for (int number : numbers) {
+            OpeningBook::build(size, number, plies, depth, threads, OpeningBook::defaultPath(size, number), cout);
+        }
+    }
+    return 0;
+}
+
+// Folds the run files named on the command line into the search cache files
+static int mergeCaches(int argc, char* argv[]) {
+    vector<string> runPaths(argv + 2, argv + argc);
+    if (runPaths.empty()) throw invalid_argument("No search cache runs to merge");
+    PersistentCache::merge(runPaths, cout);
+    return 0;
+}
+
+// Applies the interactive options to the game and runs it
+static void playInteractive(GridGame& game, int argc, char* argv[]) {
+    SearchSettings search;
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        if (i + 1 >= argc) throw invalid_argument("Missing value for " + option);
+        string value = argv[++i];
+
+        if (option == "--delay") game.setFrameDelay(stoi(value));
+        else if (option == "--search-threads") search.threads = stoi(value);
+        else if (option == "--depth") search.depth = stoi(value);
+        else if (option == "--prob-cutoff") search.probabilityCutoff = stod(value);
+        else if (option == "--time-budget") search.timeBudgetMs = stoi(value);
+        else if (option == "--weights") search.weights = EvalTuner::parseWeights(value);
+        else throw invalid_argument("Unknown option: " + option);
+    }
+    game.setSearchSettings(search);
+    game.run();
+}
 
 // Entry point of the program
-int main() {
+int main(int argc, char* argv[]) {
     try {
+        if (argc > 1 && string(argv[1]) == "--batch") {
+            return runBatch(argc, argv);
+        }
+        if (argc > 1 && string(argv[1]) == "--tune") {
+            return runTuner(argc, argv);
+        }
+        if (argc > 1 && string(argv[1]) == "--build-tablebase") {
+            return buildTablebases(argc, argv);
+        }
+        if (argc > 1 && string(argv[1]) == "--build-book") {
+            return buildBooks(argc, argv);
+        }
+        if (argc > 1 && string(argv[1]) == "--merge-cache") {
+            return mergeCaches(argc, argv);
+        }
+
         GridGame game;
-        game.run();
+        playInteractive(game, argc, argv);
     } catch (const exception& e) {
         cerr << "Error: " << e.what() << endl;
         return 1;